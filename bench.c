@@ -0,0 +1,959 @@
+// Kernel microbenchmarks for the Stable Fluids compute shaders.
+//
+// Runs every compute pass in isolation on synthetic inputs at several grid
+// sizes and reports time per dispatch, effective bytes moved and achieved
+// bandwidth against a copy kernel measured on the same grid. Kernels close to
+// the copy peak are bandwidth-bound; the rest still have headroom.
+//
+// With --autotune, every kernel whose work group size is free (TunedKernel in
+// main.c) is rebuilt with each candidate size and timed; the fastest size per
+// kernel and grid is written to workgroups.cache, which StableFluids loads at
+// startup.
+//
+// With --advection, a slotted disk is carried once around a vortex with each
+// advection scheme, and the error against the exact (initial) shape is compared
+// with the semi-Lagrangian scheme on the largest grid. --backtrace does the same
+// for each backtrace order over a range of step sizes and reports the largest
+// step that still brings the disk back to where it started.
+//
+// Usage: StableFluidsBench [--autotune | --advection | --backtrace] [grid sizes...]
+//        (default: 256 512 1024 2048; 256 512 1024 with --advection; 256 with --backtrace)
+
+#define FLUID_NO_MAIN
+#include "main.c"
+
+#define BENCH_MAX_SIZES 8
+#define BENCH_TARGET_BYTES (256.0 * 1024.0 * 1024.0)  // Traffic per measurement
+#define QUALITY_STEPS 628                              // One revolution, 0.01 rad per step
+#define QUALITY_PERIOD (QUALITY_STEPS / 60.0f)         // Seconds per revolution
+#define QUALITY_SCHEMES 3
+#define BACKTRACE_ORDERS 3
+#define BACKTRACE_MAX_DRIFT 0.01                       // Of the domain width, after one revolution
+
+typedef struct {
+    int n;                 // Cell grid is n x n
+    GLuint u[2];           // (n+1) x n
+    GLuint v[2];           // n x (n+1)
+    GLuint density[2];     // n x n RGBA32F
+    GLuint divergence;     // n x n
+    GLuint postDivergence; // n x n
+    GLuint pressure;       // n x n
+    GLuint stats;          // Histogram SSBO
+    GLuint flowPartials;   // Flow metrics SSBOs
+    GLuint flowMetrics;
+} BenchGrid;
+
+typedef struct {
+    const char* name;
+    void (*run)(const BenchGrid* g);
+    double (*bytes)(const BenchGrid* g);  // Effective bytes moved per run
+} BenchKernel;
+
+GLuint benchCopyProgram;
+GLuint benchQuery;
+
+static double cells(const BenchGrid* g) { return (double)g->n * g->n; }
+static double faces(const BenchGrid* g) { return (double)(g->n + 1) * g->n; }
+static int groups(int size) { return (size + 15) / 16; }
+
+static GLuint createBenchTexture(GLenum internalFormat, GLenum format, int width, int height,
+                                 const float* data) {
+    float borderColor[] = {0.0f, 0.0f, 0.0f, 0.0f};
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_FLOAT, data);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+    return tex;
+}
+
+// Synthetic inputs: a single vortex spanning the domain (up to ~200 cells/s,
+// a few cells of backtrace per step) and a smooth multi-colour dye pattern.
+static void createBenchGrid(BenchGrid* g, int n) {
+    memset(g, 0, sizeof(*g));
+    g->n = n;
+
+    float* uData = (float*)malloc(sizeof(float) * (n + 1) * n);
+    float* vData = (float*)malloc(sizeof(float) * n * (n + 1));
+    float* dData = (float*)malloc(sizeof(float) * 4 * n * n);
+    float c = 0.5f * n;
+    float speed = 200.0f;
+
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i <= n; i++) {
+            float y = (j + 0.5f - c) / c;  // u face at (i, j+0.5)
+            float x = (i - c) / c;
+            uData[j * (n + 1) + i] = -speed * y * expf(-2.0f * (x * x + y * y));
+        }
+    }
+    for (int j = 0; j <= n; j++) {
+        for (int i = 0; i < n; i++) {
+            float x = (i + 0.5f - c) / c;  // v face at (i+0.5, j)
+            float y = (j - c) / c;
+            vData[j * n + i] = speed * x * expf(-2.0f * (x * x + y * y));
+        }
+    }
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < n; i++) {
+            float* d = dData + 4 * (j * n + i);
+            d[0] = 0.5f + 0.5f * sinf(i * 0.05f);
+            d[1] = 0.5f + 0.5f * sinf(j * 0.07f);
+            d[2] = 0.5f + 0.5f * sinf((i + j) * 0.03f);
+            d[3] = 1.0f;
+        }
+    }
+
+    for (int k = 0; k < 2; k++) {
+        g->u[k] = createBenchTexture(GL_R32F, GL_RED, n + 1, n, uData);
+        g->v[k] = createBenchTexture(GL_R32F, GL_RED, n, n + 1, vData);
+        g->density[k] = createBenchTexture(GL_RGBA32F, GL_RGBA, n, n, dData);
+    }
+    g->divergence = createBenchTexture(GL_R32F, GL_RED, n, n, NULL);
+    g->postDivergence = createBenchTexture(GL_R32F, GL_RED, n, n, NULL);
+    g->pressure = createBenchTexture(GL_R32F, GL_RED, n, n, NULL);
+
+    glGenBuffers(1, &g->stats);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, g->stats);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(DivergenceStats2D), NULL, GL_DYNAMIC_READ);
+
+    glGenBuffers(1, &g->flowPartials);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, g->flowPartials);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)groups(n) * groups(n) * FLOW_PARTIAL_STRIDE * sizeof(float), NULL,
+                 GL_DYNAMIC_COPY);
+    glGenBuffers(1, &g->flowMetrics);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, g->flowMetrics);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(FlowMetrics), NULL, GL_DYNAMIC_COPY);
+
+    free(uData);
+    free(vData);
+    free(dData);
+}
+
+static void destroyBenchGrid(BenchGrid* g) {
+    glDeleteTextures(2, g->u);
+    glDeleteTextures(2, g->v);
+    glDeleteTextures(2, g->density);
+    glDeleteTextures(1, &g->divergence);
+    glDeleteTextures(1, &g->postDivergence);
+    glDeleteTextures(1, &g->pressure);
+    glDeleteBuffers(1, &g->stats);
+    glDeleteBuffers(1, &g->flowPartials);
+    glDeleteBuffers(1, &g->flowMetrics);
+}
+
+static void runCopy(const BenchGrid* g) {
+    glUseProgram(benchCopyProgram);
+    glBindImageTexture(0, g->density[0], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+    glBindImageTexture(1, g->density[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    glDispatchCompute(groups(g->n), groups(g->n), 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+static void runAdvectU(const BenchGrid* g) {
+    glUseProgram(advectUPipeline.program);
+    glBindImageTexture(0, g->u[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, g->u[0]);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, g->v[0]);
+    dispatchPipeline(&advectUPipeline, g->n + 1, g->n);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+static void runAdvectV(const BenchGrid* g) {
+    glUseProgram(advectVPipeline.program);
+    glBindImageTexture(0, g->v[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, g->u[0]);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, g->v[0]);
+    dispatchPipeline(&advectVPipeline, g->n, g->n + 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+static void runAdvectVelocity(const BenchGrid* g) {
+    glUseProgram(advectVelocityPipeline.program);
+    glBindImageTexture(0, g->u[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glBindImageTexture(1, g->v[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, g->u[0]);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, g->v[0]);
+    dispatchPipeline(&advectVelocityPipeline, g->n + 1, g->n + 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+static void runAdvectDensity(const BenchGrid* g) {
+    glUseProgram(advectDensityPipeline.program);
+    glBindImageTexture(0, g->u[0], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, g->v[0], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(2, g->density[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, g->density[0]);
+    dispatchPipeline(&advectDensityPipeline, g->n, g->n);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+static void runDivergence(const BenchGrid* g) {
+    glUseProgram(divergenceDensePipeline.program);
+    glBindImageTexture(0, g->u[0], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, g->v[0], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(2, g->divergence, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    dispatchPipeline(&divergenceDensePipeline, g->n, g->n);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+// One full red-black iteration (two half-passes), each split into the interior
+// (DENSE build) and the boundary tile ring as in a plain sweep of simulate()
+static void runPressure(const BenchGrid* g) {
+    glBindImageTexture(0, g->pressure, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    glBindImageTexture(1, g->divergence, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    for (int red = 1; red >= 0; red--) {
+        glUseProgram(pressureDensePipeline.program);
+        glUniform1i(pressureDenseRedPassLoc, red);
+        dispatchInterior(&pressureDensePipeline, g->n, g->n);
+        glUseProgram(pressurePipeline.program);
+        glUniform1i(pressureRedPassLoc, red);
+        dispatchRing(&pressurePipeline, g->n, g->n);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+}
+
+// The boundary build over the whole grid: bounds tests on every texel, as before the split
+static void runPressureChecked(const BenchGrid* g) {
+    glUseProgram(pressurePipeline.program);
+    glUniform1i(pressurePipeline.ringDispatchLoc, 0);
+    glBindImageTexture(0, g->pressure, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    glBindImageTexture(1, g->divergence, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glUniform1i(pressureRedPassLoc, 1);
+    dispatchPipeline(&pressurePipeline, g->n, g->n);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    glUniform1i(pressureRedPassLoc, 0);
+    dispatchPipeline(&pressurePipeline, g->n, g->n);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+// Gradient subtraction over a width x height face grid, split or checked everywhere
+static void runGradientSubtract(const ComputePipeline* interior, const ComputePipeline* boundary,
+                                GLuint in, GLuint out, GLuint pressure, int width, int height) {
+    glBindImageTexture(0, pressure, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, in, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(2, out, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    if (interior) {
+        glUseProgram(interior->program);
+        dispatchInterior(interior, width, height);
+        glUseProgram(boundary->program);
+        dispatchRing(boundary, width, height);
+    } else {
+        glUseProgram(boundary->program);
+        glUniform1i(boundary->ringDispatchLoc, 0);
+        dispatchPipeline(boundary, width, height);
+    }
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+static void runGradientSubtractU(const BenchGrid* g) {
+    runGradientSubtract(&gradientSubtractUInteriorPipeline, &gradientSubtractUPipeline,
+                        g->u[0], g->u[1], g->pressure, g->n + 1, g->n);
+}
+
+static void runGradientSubtractUChecked(const BenchGrid* g) {
+    runGradientSubtract(NULL, &gradientSubtractUPipeline, g->u[0], g->u[1], g->pressure, g->n + 1, g->n);
+}
+
+static void runGradientSubtractV(const BenchGrid* g) {
+    runGradientSubtract(&gradientSubtractVInteriorPipeline, &gradientSubtractVPipeline,
+                        g->v[0], g->v[1], g->pressure, g->n, g->n + 1);
+}
+
+static void runGradientSubtractVChecked(const BenchGrid* g) {
+    runGradientSubtract(NULL, &gradientSubtractVPipeline, g->v[0], g->v[1], g->pressure, g->n, g->n + 1);
+}
+
+static void runAddForceU(const BenchGrid* g) {
+    glUseProgram(addForceUPipeline.program);
+    glBindImageTexture(0, g->u[1], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    dispatchPipeline(&addForceUPipeline, g->n + 1, g->n);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+static void runAddForceV(const BenchGrid* g) {
+    glUseProgram(addForceVPipeline.program);
+    glBindImageTexture(0, g->v[1], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    dispatchPipeline(&addForceVPipeline, g->n, g->n + 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+static void runAddForceDensity(const BenchGrid* g) {
+    glUseProgram(addForceDensityPipeline.program);
+    glBindImageTexture(0, g->density[1], 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    dispatchPipeline(&addForceDensityPipeline, g->n, g->n);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+static void runDivergenceStats(const BenchGrid* g) {
+    glUseProgram(divergenceStatsPipeline.program);
+    glBindImageTexture(0, g->divergence, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, g->postDivergence, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, g->stats);
+    dispatchPipeline(&divergenceStatsPipeline, g->n, g->n);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+// Both halves of the reduction
+static void runFlowMetrics(const BenchGrid* g) {
+    glUseProgram(flowMetricsPipeline.program);
+    glBindImageTexture(0, g->u[0], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, g->v[0], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(2, g->density[0], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+    glBindImageTexture(3, g->divergence, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FLOW_PARTIALS_BINDING, g->flowPartials);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FLOW_METRICS_BINDING, g->flowMetrics);
+    glDispatchCompute(groups(g->n), groups(g->n), 1);  // One work group per tile
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glUseProgram(flowMetricsReducePipeline.program);
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+static void runFillR32F(const BenchGrid* g) {
+    fillTexture(&fillR32FPipeline, g->postDivergence, g->n, g->n, NULL, 0.0f);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+static void runFillRGBA32F(const BenchGrid* g) {
+    fillTexture(&fillRGBA32FPipeline, g->density[1], g->n, g->n, NULL, 0.0f);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+// Effective bytes: every input texel read once, every output texel written once
+static double bytesCopy(const BenchGrid* g)            { return cells(g) * 32.0; }
+static double bytesAdvectVelocity(const BenchGrid* g)  { return faces(g) * 4.0 * 3.0; }
+static double bytesAdvectVelocityFused(const BenchGrid* g) { return faces(g) * 4.0 * 4.0; }
+static double bytesAdvectDensity(const BenchGrid* g)   { return faces(g) * 4.0 * 2.0 + cells(g) * 32.0; }
+static double bytesDivergence(const BenchGrid* g)      { return faces(g) * 4.0 * 2.0 + cells(g) * 4.0; }
+static double bytesPressure(const BenchGrid* g)        { return 2.0 * (cells(g) * 4.0 + cells(g) * 4.0); }
+static double bytesGradientSubtract(const BenchGrid* g){ return cells(g) * 4.0 + faces(g) * 4.0 * 2.0; }
+static double bytesAddForceVelocity(const BenchGrid* g){ return faces(g) * 4.0 * 2.0; }
+static double bytesAddForceDensity(const BenchGrid* g) { return cells(g) * 32.0; }
+static double bytesDivergenceStats(const BenchGrid* g) { return cells(g) * 8.0; }
+static double bytesFlowMetrics(const BenchGrid* g)     { return faces(g) * 4.0 * 2.0 + cells(g) * 20.0; }
+static double bytesFillR32F(const BenchGrid* g)        { return cells(g) * 4.0; }
+static double bytesFillRGBA32F(const BenchGrid* g)     { return cells(g) * 16.0; }
+
+static const BenchKernel benchKernels[] = {
+    {"advect_u",            runAdvectU,           bytesAdvectVelocity},
+    {"advect_v",            runAdvectV,           bytesAdvectVelocity},
+    {"advect_velocity",     runAdvectVelocity,    bytesAdvectVelocityFused},
+    {"advect_density",      runAdvectDensity,     bytesAdvectDensity},
+    {"divergence",          runDivergence,        bytesDivergence},
+    {"pressure (r+b)",      runPressure,          bytesPressure},
+    {"  checked (no split)", runPressureChecked,  bytesPressure},
+    {"gradient_subtract_u", runGradientSubtractU, bytesGradientSubtract},
+    {"  checked (no split)", runGradientSubtractUChecked, bytesGradientSubtract},
+    {"gradient_subtract_v", runGradientSubtractV, bytesGradientSubtract},
+    {"  checked (no split)", runGradientSubtractVChecked, bytesGradientSubtract},
+    {"add_force_u",         runAddForceU,         bytesAddForceVelocity},
+    {"add_force_v",         runAddForceV,         bytesAddForceVelocity},
+    {"add_force_density",   runAddForceDensity,   bytesAddForceDensity},
+    {"divergence_stats",    runDivergenceStats,   bytesDivergenceStats},
+    {"flow_metrics",        runFlowMetrics,       bytesFlowMetrics},
+    {"fill_r32f",           runFillR32F,          bytesFillR32F},
+    {"fill_rgba32f",        runFillRGBA32F,       bytesFillRGBA32F},
+};
+
+// What --autotune times for each TunedKernel (indexed by TUNE_*)
+static const BenchKernel tunedBenchKernels[TUNE_COUNT] = {
+    {"add_force_u",       runAddForceU,       bytesAddForceVelocity},
+    {"add_force_v",       runAddForceV,       bytesAddForceVelocity},
+    {"add_force_density", runAddForceDensity, bytesAddForceDensity},
+    {"divergence",        runDivergence,      bytesDivergence},
+    {"pressure (r+b)",    runPressure,        bytesPressure},
+    {"divergence_stats",  runDivergenceStats, bytesDivergenceStats},
+    {"fill_r32f",         runFillR32F,        bytesFillR32F},
+    {"fill_rgba32f",      runFillRGBA32F,     bytesFillRGBA32F},
+};
+
+// Candidate work group shapes for --autotune; sizes that do not fit the device
+// or, for exact kernels, the interior are skipped per kernel
+static const int workGroupCandidates[][2] = {
+    {8, 8}, {16, 8}, {8, 16}, {16, 16}, {32, 4}, {32, 8}, {8, 32},
+    {32, 16}, {16, 32}, {64, 4}, {64, 2}, {128, 1}, {32, 32},
+};
+
+// Returns GPU seconds per run, averaged over enough runs to move BENCH_TARGET_BYTES
+static double timeKernel(const BenchKernel* k, const BenchGrid* g) {
+    int reps = (int)(BENCH_TARGET_BYTES / k->bytes(g));
+    if (reps < 5) reps = 5;
+    if (reps > 1000) reps = 1000;
+
+    k->run(g);  // Warm-up (first dispatch may include lazy driver work)
+    glFinish();
+
+    GLuint64 elapsed = 0;
+    double wallStart = glfwGetTime();
+    glBeginQuery(GL_TIME_ELAPSED, benchQuery);
+    for (int i = 0; i < reps; i++) {
+        k->run(g);
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    glGetQueryObjectui64v(benchQuery, GL_QUERY_RESULT, &elapsed);
+    glFinish();
+    double wall = glfwGetTime() - wallStart;
+
+    // Software implementations (e.g. llvmpipe) report near-zero elapsed time;
+    // fall back to wall-clock time bracketed by glFinish in that case
+    double gpu = (double)elapsed * 1e-9;
+    if (gpu < 1e-3 * wall) gpu = wall;
+
+    return gpu / reps;
+}
+
+// Frame constants for the grid (one centered splat adds zero force and black
+// dye) and realistic inputs for the projection kernels
+static void setupBenchInputs(const BenchGrid* g) {
+    Splat splat = {{0.5f, 0.5f}, {0.5f, 0.5f}};
+    FrameParams params = {0};
+    params.dt = 1.0f / 60.0f;
+    params.velocityDissipation = 1.0f;
+    params.densityDissipation = 0.999f;
+    params.splatCount = 1;
+    params.splatRadius = splatRadius;
+    params.splatCutoff = splatCutoffDistance(splatRadius, splatThreshold);
+    params.advectHalo = (int)ceilf(200.0f * params.dt) + 1;  // The vortex stays under 200 cells/s
+    uploadFrameParams(&params);
+    uploadSplats(&splat, 1);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SPLAT_QUEUE_BINDING, splatBuffer);
+
+    runDivergence(g);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, g->stats);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+}
+
+// Largest |difference| between the fused velocity kernel and the advect_u/v
+// pair, relative to the largest |u| or |v| of the split result
+static double fusedVelocityDifference(const BenchGrid* g) {
+    int n = g->n;
+    size_t count = (size_t)(n + 1) * n;
+    float* split = (float*)malloc(sizeof(float) * 2 * count);
+    float* fused = (float*)malloc(sizeof(float) * 2 * count);
+
+    runAdvectU(g);
+    runAdvectV(g);
+    glBindTexture(GL_TEXTURE_2D, g->u[1]);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, split);
+    glBindTexture(GL_TEXTURE_2D, g->v[1]);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, split + count);
+    runAdvectVelocity(g);
+    glBindTexture(GL_TEXTURE_2D, g->u[1]);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, fused);
+    glBindTexture(GL_TEXTURE_2D, g->v[1]);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, fused + count);
+
+    double maxDiff = 0.0, maxValue = 0.0;
+    for (size_t i = 0; i < 2 * count; i++) {
+        maxDiff = fmax(maxDiff, fabs((double)fused[i] - split[i]));
+        maxValue = fmax(maxValue, fabs((double)split[i]));
+    }
+    free(split);
+    free(fused);
+    return maxValue > 0.0 ? maxDiff / maxValue : maxDiff;
+}
+
+static void benchGridSize(int n) {
+    // Grid sizes are compiled into the kernels, so each size gets its own build,
+    // with the tuned work groups for that size if the cache has them
+    shaderConfig.gridWidth = n;
+    shaderConfig.gridHeight = n;
+    loadWorkGroupCache(WORK_GROUP_CACHE_FILE);
+    deletePipelinePrograms();
+    if (!compilePipelines()) {
+        fprintf(stderr, "Failed to compile shaders for %dx%d\n", n, n);
+        return;
+    }
+
+    BenchGrid g;
+    createBenchGrid(&g, n);
+    setupBenchInputs(&g);
+
+    BenchKernel copy = {"copy (peak)", runCopy, bytesCopy};
+    double copyTime = timeKernel(&copy, &g);
+    double peak = bytesCopy(&g) / copyTime * 1e-9;
+
+    printf("\n=== Grid %dx%d ===\n", n, n);
+    printf("%-22s %10s %10s %9s %7s\n", "Kernel", "Time(us)", "MB", "GB/s", "%Peak");
+    printf("----------------------------------------------------------------\n");
+    printf("%-22s %10.1f %10.2f %9.1f %6.0f%%\n", copy.name, copyTime * 1e6,
+           bytesCopy(&g) / (1024.0 * 1024.0), peak, 100.0);
+
+    for (size_t i = 0; i < sizeof(benchKernels) / sizeof(benchKernels[0]); i++) {
+        const BenchKernel* k = &benchKernels[i];
+        double t = timeKernel(k, &g);
+        double bytes = k->bytes(&g);
+        double gbps = bytes / t * 1e-9;
+        printf("%-22s %10.1f %10.2f %9.1f %6.0f%%\n", k->name, t * 1e6,
+               bytes / (1024.0 * 1024.0), gbps, 100.0 * gbps / peak);
+    }
+    printf("advect_velocity vs advect_u + advect_v: max difference %.2e of max |u|\n",
+           fusedVelocityDifference(&g));
+
+    destroyBenchGrid(&g);
+}
+
+// Time every tuned kernel with each candidate work group and keep the fastest.
+// Each round builds all kernels with one candidate (kernels it does not fit
+// keep the default), so the rounds cost one compilePipelines() each.
+static void autotuneGridSize(int n) {
+    shaderConfig.gridWidth = n;
+    shaderConfig.gridHeight = n;
+
+    BenchGrid g;
+    createBenchGrid(&g, n);
+
+    int numCandidates = (int)(sizeof(workGroupCandidates) / sizeof(workGroupCandidates[0]));
+    double defaultTime[TUNE_COUNT] = {0};
+    double bestTime[TUNE_COUNT];
+    int bestSize[TUNE_COUNT][2];
+    for (int k = 0; k < TUNE_COUNT; k++) {
+        bestTime[k] = 1e30;
+        bestSize[k][0] = shaderConfig.localSizeX;
+        bestSize[k][1] = shaderConfig.localSizeY;
+    }
+
+    printf("\n=== Autotune %dx%d ===\n", n, n);
+
+    // Round -1 is the default size, the baseline the speedups are relative to
+    for (int c = -1; c < numCandidates; c++) {
+        int x = c < 0 ? shaderConfig.localSizeX : workGroupCandidates[c][0];
+        int y = c < 0 ? shaderConfig.localSizeY : workGroupCandidates[c][1];
+        if (c >= 0 && x == shaderConfig.localSizeX && y == shaderConfig.localSizeY) continue;
+
+        int fits[TUNE_COUNT];
+        int anyFits = 0;
+        for (int k = 0; k < TUNE_COUNT; k++) {
+            fits[k] = workGroupFits(k, x, y);
+            anyFits |= fits[k];
+            tunedKernels[k].localSize[0] = fits[k] ? x : shaderConfig.localSizeX;
+            tunedKernels[k].localSize[1] = fits[k] ? y : shaderConfig.localSizeY;
+        }
+        if (!anyFits) continue;
+
+        deletePipelinePrograms();
+        if (!compilePipelines()) {
+            fprintf(stderr, "Failed to compile shaders with %dx%d work groups\n", x, y);
+            continue;
+        }
+        setupBenchInputs(&g);
+
+        for (int k = 0; k < TUNE_COUNT; k++) {
+            if (!fits[k]) continue;
+            double t = timeKernel(&tunedBenchKernels[k], &g);
+            if (c < 0) defaultTime[k] = t;
+            if (t < bestTime[k]) {
+                bestTime[k] = t;
+                bestSize[k][0] = x;
+                bestSize[k][1] = y;
+            }
+        }
+    }
+
+    printf("%-20s %10s %8s %10s %8s\n", "Kernel", "Default", "Best", "Time(us)", "Speedup");
+    printf("----------------------------------------------------------------\n");
+    for (int k = 0; k < TUNE_COUNT; k++) {
+        char size[16];
+        snprintf(size, sizeof(size), "%dx%d", bestSize[k][0], bestSize[k][1]);
+        printf("%-20s %10.1f %8s %10.1f %7.2fx\n", tunedBenchKernels[k].name, defaultTime[k] * 1e6, size,
+               bestTime[k] * 1e6, defaultTime[k] / bestTime[k]);
+        tunedKernels[k].localSize[0] = bestSize[k][0];
+        tunedKernels[k].localSize[1] = bestSize[k][1];
+    }
+    if (saveWorkGroupCache(WORK_GROUP_CACHE_FILE)) printf("Saved to %s\n", WORK_GROUP_CACHE_FILE);
+
+    destroyBenchGrid(&g);
+}
+
+// Advection quality: Zalesak's slotted disk (radius 0.15 at (0.5, 0.75), slot
+// 0.05 wide) turned once around the centre by a Rankine vortex. Its core, which
+// turns as a solid body, has radius 0.42 and holds the whole orbit, so the exact
+// answer is the initial disk and whatever differs is numerical error.
+typedef struct {
+    int n;
+    GLuint u, v;           // Rotation, cells/s
+    GLuint density[2];
+    GLuint hat, tilde;     // MacCormack/BFECC intermediates
+    float* initial;        // n x n RGBA, the disk in every channel
+} QualityGrid;
+
+typedef struct {
+    double l1;             // Mean |error| per cell: the fraction of the area that is wrong
+    double smeared;        // Fraction of the area strictly between 0.05 and 0.95
+    double drift;          // Distance of the dye centroid from its start, cells
+    float min, max;
+    double stepTime;       // GPU seconds per step, all stages
+} QualityResult;
+
+static const char* qualitySchemeNames[QUALITY_SCHEMES] = {"semi-Lagrangian", "MacCormack", "BFECC"};
+
+static void createQualityGrid(QualityGrid* q, int n) {
+    memset(q, 0, sizeof(*q));
+    q->n = n;
+
+    // One revolution per QUALITY_PERIOD; outside the core the angular speed falls off as 1/r^2
+    float omega = 2.0f * 3.14159265f / QUALITY_PERIOD;
+    float c = 0.5f * n;
+    float core = 0.42f * n;
+    float* uData = (float*)malloc(sizeof(float) * (n + 1) * n);
+    float* vData = (float*)malloc(sizeof(float) * n * (n + 1));
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i <= n; i++) {
+            float x = i - c, y = j + 0.5f - c;  // u face at (i, j+0.5)
+            float r2 = x * x + y * y;
+            uData[j * (n + 1) + i] = -omega * (r2 > core * core ? core * core / r2 : 1.0f) * y;
+        }
+    }
+    for (int j = 0; j <= n; j++) {
+        for (int i = 0; i < n; i++) {
+            float x = i + 0.5f - c, y = j - c;  // v face at (i+0.5, j)
+            float r2 = x * x + y * y;
+            vData[j * n + i] = omega * (r2 > core * core ? core * core / r2 : 1.0f) * x;
+        }
+    }
+
+    q->initial = (float*)malloc(sizeof(float) * 4 * n * n);
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < n; i++) {
+            float x = (i + 0.5f) / n - 0.5f;
+            float y = (j + 0.5f) / n - 0.75f;
+            int inside = x * x + y * y < 0.15f * 0.15f && !(fabsf(x) < 0.025f && y < 0.1f);
+            for (int k = 0; k < 4; k++) q->initial[4 * (j * n + i) + k] = inside ? 1.0f : 0.0f;
+        }
+    }
+
+    q->u = createBenchTexture(GL_R32F, GL_RED, n + 1, n, uData);
+    q->v = createBenchTexture(GL_R32F, GL_RED, n, n + 1, vData);
+    for (int k = 0; k < 2; k++) q->density[k] = createBenchTexture(GL_RGBA32F, GL_RGBA, n, n, NULL);
+    q->hat = createBenchTexture(GL_RGBA32F, GL_RGBA, n, n, NULL);
+    q->tilde = createBenchTexture(GL_RGBA32F, GL_RGBA, n, n, NULL);
+    free(uData);
+    free(vData);
+}
+
+static void destroyQualityGrid(QualityGrid* q) {
+    glDeleteTextures(1, &q->u);
+    glDeleteTextures(1, &q->v);
+    glDeleteTextures(2, q->density);
+    glDeleteTextures(1, &q->hat);
+    glDeleteTextures(1, &q->tilde);
+    free(q->initial);
+}
+
+// One revolution in `steps` steps, tracing the dye with the given backtrace order
+static void setupQualityParams(int steps, int order) {
+    FrameParams params = {0};
+    params.dt = QUALITY_PERIOD / steps;
+    params.velocityDissipation = 1.0f;
+    params.densityDissipation = 1.0f;
+    params.velocityBacktraceOrder = order;
+    params.densityBacktraceOrder = order;
+    uploadFrameParams(&params);
+}
+
+// One advect_density.comp build from src (and advected, for the later stages) into out
+static void dispatchQualityAdvect(const ComputePipeline* p, const QualityGrid* q, GLuint src, GLuint advected,
+                                  GLuint out) {
+    glUseProgram(p->program);
+    glBindImageTexture(0, q->u, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, q->v, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(2, out, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, src);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, advected);
+    dispatchPipeline(p, q->n, q->n);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+// One step of scheme (ADVECTION_*) from density[k] into density[1 - k], staged as in addFieldAdvection()
+static void qualityStep(const QualityGrid* q, int scheme, int k) {
+    GLuint src = q->density[k];
+    GLuint out = q->density[1 - k];
+    if (scheme == ADVECTION_SEMI_LAGRANGIAN) {
+        dispatchQualityAdvect(&advectDensityPipeline, q, src, 0, out);
+        return;
+    }
+    dispatchQualityAdvect(&advectDensityStagePipelines[ADVECT_STAGE_PREDICT], q, src, 0, q->hat);
+    if (scheme == ADVECTION_MACCORMACK) {
+        dispatchQualityAdvect(&advectDensityStagePipelines[ADVECT_STAGE_MACCORMACK], q, src, q->hat, out);
+    } else {
+        dispatchQualityAdvect(&advectDensityStagePipelines[ADVECT_STAGE_BFECC_ERROR], q, src, q->hat, q->tilde);
+        dispatchQualityAdvect(&advectDensityStagePipelines[ADVECT_STAGE_BFECC_FINAL], q, src, q->tilde, out);
+    }
+}
+
+// Mean position of the cells where channel 0 is above one half, in cells. The
+// half-level contour stays put under numerical diffusion, the diffuse tails don't.
+static void dyeCentroid(const float* rgba, int n, double* cx, double* cy) {
+    double sum = 0.0, sx = 0.0, sy = 0.0;
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < n; i++) {
+            if (rgba[4 * (j * n + i)] <= 0.5f) continue;
+            sum += 1.0;
+            sx += i + 0.5;
+            sy += j + 0.5;
+        }
+    }
+    *cx = sum > 0.0 ? sx / sum : 0.0;
+    *cy = sum > 0.0 ? sy / sum : 0.0;
+}
+
+// One revolution in `steps` steps (see setupQualityParams)
+static void runQuality(const QualityGrid* q, int scheme, int steps, QualityResult* r) {
+    int n = q->n;
+    glBindTexture(GL_TEXTURE_2D, q->density[0]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, n, n, GL_RGBA, GL_FLOAT, q->initial);
+    qualityStep(q, scheme, 0);  // Warm-up; its output is overwritten by the first timed step
+    glFinish();
+
+    GLuint64 elapsed = 0;
+    double wallStart = glfwGetTime();
+    glBeginQuery(GL_TIME_ELAPSED, benchQuery);
+    for (int s = 0; s < steps; s++) qualityStep(q, scheme, s & 1);
+    glEndQuery(GL_TIME_ELAPSED);
+    glGetQueryObjectui64v(benchQuery, GL_QUERY_RESULT, &elapsed);
+    glFinish();
+    double wall = glfwGetTime() - wallStart;
+    double gpu = (double)elapsed * 1e-9;
+    if (gpu < 1e-3 * wall) gpu = wall;  // Software renderers, as in timeKernel()
+    r->stepTime = gpu / steps;
+
+    float* result = (float*)malloc(sizeof(float) * 4 * n * n);
+    glBindTexture(GL_TEXTURE_2D, q->density[steps & 1]);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, result);
+    double l1 = 0.0;
+    int smeared = 0;
+    r->min = 1e30f;
+    r->max = -1e30f;
+    for (int i = 0; i < n * n; i++) {
+        float d = result[4 * i];
+        l1 += fabs(d - q->initial[4 * i]);
+        smeared += d > 0.05f && d < 0.95f;
+        if (d < r->min) r->min = d;
+        if (d > r->max) r->max = d;
+    }
+    r->l1 = l1 / ((double)n * n);
+    r->smeared = (double)smeared / ((double)n * n);
+
+    double x0, y0, x1, y1;
+    dyeCentroid(q->initial, n, &x0, &y0);
+    dyeCentroid(result, n, &x1, &y1);
+    r->drift = sqrt((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0));
+    free(result);
+}
+
+// Every scheme on every grid; ratios are against semi-Lagrangian on the last (largest) grid
+static void advectionQuality(const int* sizes, int numSizes) {
+    QualityResult results[BENCH_MAX_SIZES][QUALITY_SCHEMES];
+    int ran[BENCH_MAX_SIZES] = {0};
+
+    for (int s = 0; s < numSizes; s++) {
+        int n = sizes[s];
+        shaderConfig.gridWidth = n;
+        shaderConfig.gridHeight = n;
+        loadWorkGroupCache(WORK_GROUP_CACHE_FILE);
+        deletePipelinePrograms();
+        if (!compilePipelines()) {
+            fprintf(stderr, "Failed to compile shaders for %dx%d\n", n, n);
+            continue;
+        }
+        setupQualityParams(QUALITY_STEPS, 1);
+
+        QualityGrid q;
+        createQualityGrid(&q, n);
+        for (int k = 0; k < QUALITY_SCHEMES; k++) runQuality(&q, k, QUALITY_STEPS, &results[s][k]);
+        destroyQualityGrid(&q);
+        ran[s] = 1;
+    }
+
+    int ref = numSizes - 1;
+    while (ref >= 0 && !ran[ref]) ref--;
+    if (ref < 0) return;
+    const QualityResult* base = &results[ref][ADVECTION_SEMI_LAGRANGIAN];
+
+    printf("\n=== Advection quality: slotted disk, one revolution in %d steps ===\n", QUALITY_STEPS);
+    printf("%-16s %6s %8s %9s %8s %6s %6s %9s %7s %7s\n", "Scheme", "Grid", "Cells", "L1 error", "Smeared",
+           "Min", "Max", "us/step", "Error", "Time");
+    printf("-----------------------------------------------------------------------------------------------\n");
+    for (int s = 0; s < numSizes; s++) {
+        if (!ran[s]) continue;
+        for (int k = 0; k < QUALITY_SCHEMES; k++) {
+            const QualityResult* r = &results[s][k];
+            printf("%-16s %6d %8d %9.5f %7.2f%% %6.3f %6.3f %9.1f %6.2fx %6.2fx\n", qualitySchemeNames[k],
+                   sizes[s], sizes[s] * sizes[s], r->l1, r->smeared * 100.0, r->min, r->max,
+                   r->stepTime * 1e6, r->l1 / base->l1, r->stepTime / base->stepTime);
+        }
+    }
+    printf("\nError and Time are relative to semi-Lagrangian at %dx%d. L1 error is the\n", sizes[ref], sizes[ref]);
+    printf("fraction of the domain that is wrong, Smeared the part between 5%% and 95%%.\n");
+    printf("Min and max stay in [0, 1] with the limiter.\n");
+}
+
+// Steps per revolution tried by --backtrace, from fine to coarse
+static const int backtraceSteps[] = {1024, 512, 256, 128, 96, 64, 48, 32, 24, 16, 12, 8};
+
+// Semi-Lagrangian dye advection with each backtrace order, one revolution in
+// fewer and fewer steps. An order is stable at a step size while it and every
+// smaller one bring the dye centroid back within BACKTRACE_MAX_DRIFT of the
+// domain. An Euler trace leaves the circle on every step, so the disk spirals
+// off its orbit long before it blurs.
+static void backtraceStability(int n) {
+    shaderConfig.gridWidth = n;
+    shaderConfig.gridHeight = n;
+    loadWorkGroupCache(WORK_GROUP_CACHE_FILE);
+    deletePipelinePrograms();
+    if (!compilePipelines()) {
+        fprintf(stderr, "Failed to compile shaders for %dx%d\n", n, n);
+        return;
+    }
+
+    const char* orderNames[BACKTRACE_ORDERS] = {"Euler", "RK2", "RK3"};
+    int numSteps = (int)(sizeof(backtraceSteps) / sizeof(backtraceSteps[0]));
+    double maxDrift = BACKTRACE_MAX_DRIFT * n;
+    int stable[BACKTRACE_ORDERS] = {-1, -1, -1};  // Index of the largest stable step
+    int failed[BACKTRACE_ORDERS] = {0};
+
+    QualityGrid q;
+    createQualityGrid(&q, n);
+
+    printf("\n=== Backtrace order: slotted disk in a Rankine vortex, one revolution, %dx%d ===\n", n, n);
+    printf("%6s %8s %7s", "Steps", "dt(ms)", "CFL");
+    for (int k = 0; k < BACKTRACE_ORDERS; k++) printf(" | %5s %8s %7s", orderNames[k], "L1", "Drift");
+    printf("\n");
+    printf("----------------------------------------------------------------------------------------\n");
+    for (int s = 0; s < numSteps; s++) {
+        int steps = backtraceSteps[s];
+        float dt = QUALITY_PERIOD / steps;
+        // Fastest point of the orbit: the outer edge of the disk, 0.4 of the domain from the centre
+        float cfl = 2.0f * 3.14159265f / QUALITY_PERIOD * 0.4f * n * dt;
+        printf("%6d %8.2f %7.2f", steps, dt * 1000.0f, cfl);
+        for (int k = 0; k < BACKTRACE_ORDERS; k++) {
+            QualityResult r;
+            setupQualityParams(steps, k + 1);
+            runQuality(&q, ADVECTION_SEMI_LAGRANGIAN, steps, &r);
+            int ok = r.drift <= maxDrift;
+            if (!ok) failed[k] = 1;
+            if (!failed[k]) stable[k] = s;
+            printf(" | %5s %8.5f %7.2f", ok ? "" : "drift", r.l1, r.drift);
+        }
+        printf("\n");
+    }
+    destroyQualityGrid(&q);
+
+    printf("\nLargest stable step (centroid back within %.1f cells, %.0f%% of the domain):\n", maxDrift,
+           BACKTRACE_MAX_DRIFT * 100.0);
+    for (int k = 0; k < BACKTRACE_ORDERS; k++) {
+        if (stable[k] < 0) {
+            printf("  %-6s none of the step sizes\n", orderNames[k]);
+            continue;
+        }
+        int steps = backtraceSteps[stable[k]];
+        printf("  %-6s %4d steps per revolution (dt %.1f ms, %.1fx the Euler step)\n", orderNames[k], steps,
+               QUALITY_PERIOD / steps * 1000.0f,
+               stable[0] < 0 ? 0.0 : (double)backtraceSteps[stable[0]] / steps);
+    }
+    printf("Drift and L1 are the dye centroid's distance from its start (cells) and the\n");
+    printf("fraction of the domain that is wrong. CFL is at the outer edge of the disk.\n");
+}
+
+int main(int argc, char** argv) {
+    int sizes[BENCH_MAX_SIZES] = {256, 512, 1024, 2048};
+    int numSizes = 4;
+    int autotune = 0;
+    int advection = 0;
+    int backtrace = 0;
+
+    int explicitSizes = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--autotune") == 0) {
+            autotune = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--advection") == 0) {
+            advection = 1;
+            if (!explicitSizes) numSizes = 3;
+            continue;
+        }
+        if (strcmp(argv[i], "--backtrace") == 0) {
+            backtrace = 1;
+            if (!explicitSizes) numSizes = 1;
+            continue;
+        }
+        if (!explicitSizes) numSizes = 0;
+        explicitSizes = 1;
+        int n = atoi(argv[i]);
+        if (n >= 16 && numSizes < BENCH_MAX_SIZES) sizes[numSizes++] = n;
+    }
+
+    if (!glfwInit()) {
+        fprintf(stderr, "Failed to initialize GLFW\n");
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    GLFWwindow* window = glfwCreateWindow(64, 64, "Stable Fluids Bench", NULL, NULL);
+    if (!window) {
+        fprintf(stderr, "Failed to create GLFW window\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        fprintf(stderr, "Failed to initialize GLAD\n");
+        return -1;
+    }
+
+    printf("OpenGL %s\n", glGetString(GL_VERSION));
+    printf("Renderer: %s\n", glGetString(GL_RENDERER));
+
+    int pipelinesOk = createPipelines();
+    benchCopyProgram = createComputeShader("shaders/bench_copy.comp");
+
+    if (!pipelinesOk || !benchCopyProgram) {
+        fprintf(stderr, "Failed to load shaders\n");
+        glfwTerminate();
+        return -1;
+    }
+
+    glGenQueries(1, &benchQuery);
+
+    if (advection) {
+        advectionQuality(sizes, numSizes);
+    } else if (backtrace) {
+        for (int i = 0; i < numSizes; i++) backtraceStability(sizes[i]);
+    } else {
+        for (int i = 0; i < numSizes; i++) {
+            if (autotune) autotuneGridSize(sizes[i]);
+            else benchGridSize(sizes[i]);
+        }
+    }
+
+    if (!autotune && !advection && !backtrace) {
+        printf("\n%%Peak is relative to the copy kernel on the same grid; kernels near 100%%\n");
+        printf("are bandwidth-bound, lower values leave headroom for optimization.\n");
+    }
+
+    glDeleteQueries(1, &benchQuery);
+    glDeleteProgram(benchCopyProgram);
+    destroyPipelines();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
@@ -3,6 +3,8 @@
 #include <string.h>
 #include <math.h>
 #include <limits.h>
+#include <stdint.h>
+#include <stddef.h>
 
 // Force discrete GPU on Optimus/PowerXpress systems
 #ifdef _WIN32
@@ -10,6 +12,25 @@ __declspec(dllexport) unsigned long NvOptimusEnablement = 1;
 __declspec(dllexport) unsigned long AmdPowerXpressRequestHighPerformance = 1;
 #endif
 
+// Threads, sleeps and the few atomics the simulation thread handoff needs
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <mmsystem.h>              // timeBeginPeriod: 1 ms sleeps for the simulation tick
+typedef HANDLE ThreadHandle;
+#define atomicLoad(p)        InterlockedOr((p), 0)
+#define atomicStore(p, v)    ((void)InterlockedExchange((p), (v)))
+#define atomicExchange(p, v) InterlockedExchange((p), (v))
+#else
+#include <pthread.h>
+#include <time.h>
+typedef pthread_t ThreadHandle;
+#define atomicLoad(p)        __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define atomicStore(p, v)    __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define atomicExchange(p, v) __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#endif
+
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
@@ -24,43 +45,558 @@ __declspec(dllexport) unsigned long AmdPowerXpressRequestHighPerformance = 1;
 #define V_WIDTH  SIM_WIDTH         // 512
 #define V_HEIGHT (SIM_HEIGHT + 1)  // 513 - horizontal faces (one extra row)
 
-// Solver parameters
+// Solver parameters. ω is compiled into pressure.comp; change it with setPressureOmega().
 int pressureIterations = 128;
-float pressureOmega = 1.8f;
+float pressureOmega = 1.9f;
+
+// Splat parameters. Gaussian splats are truncated where they fall below
+// splatThreshold, which bounds the region the emitter passes dispatch over.
+float splatRadius = 0.02f;
+float splatThreshold = 1e-4f;
+
+// Advection scheme for velocity and dye. MacCormack and BFECC correct the
+// semi-Lagrangian step by the error of a forward-backward round trip (two and
+// three kernels per field), limited to the range of the texels the plain step
+// would have blended. Less numerical diffusion, so a smaller grid keeps detail.
+#define ADVECTION_SEMI_LAGRANGIAN 0
+#define ADVECTION_MACCORMACK      1
+#define ADVECTION_BFECC           2
+int advectionScheme = ADVECTION_SEMI_LAGRANGIAN;
+
+// Backtrace integration order per field: 1 Euler, 2 midpoint (RK2), 3 Ralston's
+// RK3. The higher orders sample the velocity at the intermediate points, so a
+// long step follows curved flow instead of its tangent and fewer substeps do.
+int velocityBacktraceOrder = 1;
+int densityBacktraceOrder = 1;
+
+// Velocity advection in one dispatch (advect_velocity.comp) instead of the
+// advect_u/advect_v pair. Each work group stages its tile of u and v with a
+// halo of advectHalo cells in shared memory and samples the velocity there.
+// The halo is the distance the step can trace at the estimated max speed, up
+// to ADVECT_HALO_MAX, which shaderConfigDefines() passes to the shaders and
+// which sizes their shared tile; samples beyond it read the textures. Off (U turns it on) until a StableFluidsBench run shows
+// advect_velocity beating advect_u plus advect_v; on llvmpipe it is slower.
+#define ADVECT_HALO_MAX 8
+int fusedVelocityAdvection = 0;
+int advectHalo = ADVECT_HALO_MAX;  // Of the newest step
+
+// Sparse active tiles. The staggered grid is covered by 16x16 tiles (matching
+// the kernels' local size); advection and pre-divergence only run on tiles
+// within tileMargin of a tile holding velocity or dye above the thresholds.
+#define TILE_SIZE 16
+#define TILES_X ((U_WIDTH + TILE_SIZE - 1) / TILE_SIZE)   // 33 - covers the extra u column
+#define TILES_Y ((V_HEIGHT + TILE_SIZE - 1) / TILE_SIZE)  // 33 - covers the extra v row
+#define TILE_COUNT (TILES_X * TILES_Y)
+int sparseTiles = 1;
+float tileVelocityEpsilon = 1e-2f;  // cells/sec
+float tileDensityEpsilon = 1e-3f;
+int tileMargin = 1;
+
+// Active-set pressure solve. Every solveCheckInterval-th sweep covers the whole
+// grid and records each 16x16 cell tile's largest residual; the sweeps between
+// checks only visit tiles with a neighbour above solveTolerance.
+#define SOLVE_TILES_X ((SIM_WIDTH + TILE_SIZE - 1) / TILE_SIZE)   // 32
+#define SOLVE_TILES_Y ((SIM_HEIGHT + TILE_SIZE - 1) / TILE_SIZE)  // 32
+#define SOLVE_TILE_COUNT (SOLVE_TILES_X * SOLVE_TILES_Y)
+int activeSetSolve = 1;
+int solveCheckInterval = 8;
+float solveTolerance = 1e-4f;  // Residual of the 5-point equation (divergence units)
 
 typedef struct {
     unsigned int histogram[32 * 36];  // [postBin * 36 + preBin], pre-bins 0-35, post-bins 0-31
 } DivergenceStats2D;
 
+// Histogram summary for the convergence overlay (std430, binding 6), written by
+// stats_summary.comp and read by stats_overlay.frag; see shaders/include/stats.glsl
+#define STATS_SUMMARY_BINDING 6
+typedef struct {
+    GLuint preSums[36];
+    GLuint postSums[32];
+    GLint topPreBins[3];      // Bin index (exponent + 24), -1 if fewer non-empty bins
+    GLuint topPreCounts[3];
+    GLint topPostBins[3];
+    GLuint topPostCounts[3];
+    GLuint maxCount;
+} StatsSummary;
+
+// Ring of the last HISTORY_FRAMES summaries' marginals (std430, binding 7),
+// appended by stats_summary.comp; see StatsHistory in shaders/include/stats.glsl.
+// The GPU keeps the counts, the CPU what it knew about each entry's frame.
+#define STATS_HISTORY_BINDING 7
+#define HISTORY_FRAMES 4096
+#define STATS_HISTORY_BYTES (sizeof(GLuint) * (1 + HISTORY_FRAMES * (36 + 32)))
+#define STATS_HISTORY_FILE "convergence_history.csv"
+typedef struct {
+    unsigned int simFrame;
+    double time;              // glfwGetTime() when the frame was built
+    float dt;
+    int iterations;
+    float omega;
+    int sparseTiles;
+    int activeSetSolve;
+    int debugTestMode;
+} StatsHistoryEntry;
+
+// Compute pipeline: program plus everything resolved once at load time.
+// Per-frame constants live in the FrameParams uniform buffer, samplers and
+// images use layout bindings, so dispatching needs no string lookups.
+typedef struct {
+    GLuint program;
+    GLint localSize[3];  // GL_COMPUTE_WORK_GROUP_SIZE, used to size dispatches
+    GLint originLoc;     // "dispatchOrigin" for kernels run over a sub-rectangle, else -1
+    GLint tileDispatchLoc;  // "tileDispatch" for kernels that can walk the active-tile list, else -1
+    GLint ringDispatchLoc;  // "ringDispatch" for boundary kernels run over the outer tile ring, else -1
+} ComputePipeline;
+
+// Per-frame constants shared by all compute shaders (std140, binding 0).
+// Must match the FrameParams block declared in the shaders.
+typedef struct {
+    float dt;
+    float velocityDissipation;
+    float densityDissipation;
+    int splatCount;         // Splats queued this frame
+    float splatRadius;      // Radius of influence (in UV space)
+    float splatCutoff;      // Truncation distance (in UV space), see splatCutoffDistance()
+    float tileVelocityEpsilon;
+    float tileDensityEpsilon;
+    int tileMargin;
+    float solveTolerance;
+    int velocityBacktraceOrder;  // See velocityBacktraceOrder below
+    int densityBacktraceOrder;
+    int advectHalo;              // Cells advect_velocity.comp stages around its tile
+    int pad[3];
+} FrameParams;
+
+#define FRAME_PARAMS_BINDING 0
+
+// Compile-time configuration of the compute shaders. shaderConfigDefines() turns
+// it into #defines in front of every compute shader, so grid sizes and work
+// group sizes are constants and the index math on them folds away. One source
+// tree gives a specialized build per configuration; changing a field means
+// recompiling (compilePipelines()).
+typedef struct {
+    int gridWidth, gridHeight;   // Cell grid; u is one column wider, v one row taller
+    int localSizeX, localSizeY;  // Default work group of the tuned kernels (TunedKernel)
+} ShaderConfig;
+
+ShaderConfig shaderConfig = {SIM_WIDTH, SIM_HEIGHT, 16, 16};
+
+// Kernels whose work group size is not tied to TILE_SIZE. Each builds with
+// shaderConfig's default size unless loadWorkGroupCache() finds a size that
+// StableFluidsBench --autotune measured faster for this renderer and grid.
+#define TUNE_ADD_FORCE_U      0
+#define TUNE_ADD_FORCE_V      1
+#define TUNE_ADD_FORCE_DENSITY 2
+#define TUNE_DIVERGENCE       3  // DENSE build (full-grid passes)
+#define TUNE_PRESSURE         4  // DENSE interior build (plain full sweeps)
+#define TUNE_DIVERGENCE_STATS 5
+#define TUNE_FILL_R32F        6
+#define TUNE_FILL_RGBA32F     7
+#define TUNE_COUNT            8
+
+typedef struct {
+    const char* name;   // Cache key
+    int exact;          // No bounds tests: the size must divide the interior (interiorRect)
+    int localSize[2];
+} TunedKernel;
+
+TunedKernel tunedKernels[TUNE_COUNT] = {
+    {"add_force_u"}, {"add_force_v"}, {"add_force_density"}, {"divergence"},
+    {"pressure", 1}, {"divergence_stats"}, {"fill_r32f"}, {"fill_rgba32f"},
+};
+
+#define WORK_GROUP_CACHE_FILE "workgroups.cache"
+
+// Image formats of the simulation fields: textures, frame graph image bindings
+// and the shaders' layout qualifiers. The fill shaders clear them as r32f and
+// rgba32f, so a different format needs a matching fill pipeline.
+#define VELOCITY_FORMAT GL_R32F
+#define DENSITY_FORMAT GL_RGBA32F
+
+// Shader text after #include expansion. files[i] is source string i in the
+// compiler's messages ("i:line"), with the shader itself at 0.
+#define SHADER_MAX_FILES 16
+typedef struct {
+    char* text;
+    size_t length, capacity;
+    int fileCount;
+    char files[SHADER_MAX_FILES][256];
+} ShaderSource;
+
+// One mouse stroke segment (std430, SplatQueue buffer at binding 1). The force
+// shaders apply all queued splats in one pass, each as a capsule from start to end.
+typedef struct {
+    float start[2];         // Segment start (0-1 in cell-center space)
+    float end[2];           // Segment end
+    float force[2];         // Force (grid cells/sec)
+    float pad[2];
+    float color[4];         // Dye color (rgb)
+} Splat;
+
+#define SPLAT_QUEUE_BINDING 1
+#define MAX_SPLATS 64       // Further events extend the last segment
+#define MAX_VELOCITY 3840.0f  // Clamp in add_force_u/v.comp, cells/s
+
+// Active-tile buffers (std430). The list buffer starts with two indirect dispatch
+// commands (active tiles, then retiring tiles) followed by the two tile lists;
+// the flags buffer holds this frame's mask and each tile's retire countdown.
+#define TILE_LIST_BINDING 2
+#define TILE_FLAGS_BINDING 3
+#define TILE_ACTIVE_COMMAND 0    // Byte offsets of the dispatch commands
+#define TILE_RETIRE_COMMAND 12
+#define TILE_LIST_BYTES (6 * sizeof(GLuint) + 2 * TILE_COUNT * sizeof(GLuint))
+#define TILE_FLAGS_BYTES (2 * TILE_COUNT * sizeof(GLuint))
+
+// Pressure active set (std430): dispatch commands for the interior and boundary
+// tiles, swept-tile counter, the two tile lists; and the per-tile residuals
+// recorded by the check sweeps
+#define SOLVE_LIST_BINDING 4
+#define SOLVE_RESIDUAL_BINDING 5
+#define SOLVE_INTERIOR_COMMAND 0
+#define SOLVE_SWEPT_OFFSET 12
+#define SOLVE_BOUNDARY_COMMAND 16
+#define SOLVE_LIST_BYTES ((8 + 2 * SOLVE_TILE_COUNT) * sizeof(GLuint))
+#define SOLVE_RESIDUAL_BYTES (SOLVE_TILE_COUNT * sizeof(GLuint))
+
+// Flow metrics (std430): flow_metrics.comp writes one partial per cell tile
+// (binding 9), flow_metrics_reduce.comp the final values (binding 8). Must
+// match shaders/include/flow_metrics.glsl. Grid units: velocity in cells/s.
+// The hot spots are the worst |divergence| cell of each of the HOT_SPOTS
+// worst tiles, packed x | y << 16.
+#define FLOW_METRICS_BINDING 8
+#define FLOW_PARTIALS_BINDING 9
+#define FLOW_PARTIAL_STRIDE 12    // Floats per tile partial
+#define HOT_SPOTS 4
+#define NO_HOT_SPOT 0xFFFFFFFFu
+typedef struct {
+    float kineticEnergy;      // 0.5 * sum |u|^2 at cell centres
+    float enstrophy;          // 0.5 * sum of squared vorticity at interior corners
+    float preDivergenceL2;    // RMS over the cells
+    float postDivergenceL2;
+    float dyeMass;            // Sum of r + g + b
+    float maxU;               // Largest |u| on a vertical face
+    float maxV;               // Largest |v| on a horizontal face
+    float maxSpeed;           // Largest |u| at a cell centre
+    float preDivergenceMax;
+    float postDivergenceMax;
+    GLuint hotSpotCells[2][HOT_SPOTS];   // [0] pre, [1] post projection; largest first
+    float hotSpotValues[2][HOT_SPOTS];   // |divergence|, 0 where NO_HOT_SPOT
+} FlowMetrics;
+#define FLOW_PARTIALS_BYTES (SOLVE_TILE_COUNT * FLOW_PARTIAL_STRIDE * sizeof(float))
+
+// The reduced metrics are copied into one of METRICS_READBACK_FRAMES slots behind
+// a fence and read once the fence has passed, so the CPU never waits for them
+#define METRICS_READBACK_FRAMES 3
+typedef struct {
+    GLuint buffer;                                // METRICS_READBACK_FRAMES FlowMetrics
+    GLsync fences[METRICS_READBACK_FRAMES];       // Pending copy into each slot
+    unsigned int frames[METRICS_READBACK_FRAMES]; // simFrame each slot measured
+    float dts[METRICS_READBACK_FRAMES];
+    int next;                                     // Slot for the next copy
+    unsigned int dropped;                         // Copies skipped, every slot in flight
+} MetricsReadback;
+
+// The HUD's active-tile count and swept-tile counter (while diagnostics are on)
+// travel the same way: two GLuints per slot, copied from tileListBuffer and
+// solveListBuffer behind a fence and shown once it has passed
+#define COUNTER_ACTIVE_TILES 0
+#define COUNTER_SWEPT_TILES  1
+#define COUNTER_SLOT_BYTES   (2 * sizeof(GLuint))
+typedef struct {
+    GLuint buffer;                                // METRICS_READBACK_FRAMES slots
+    GLsync fences[METRICS_READBACK_FRAMES];
+    int tilesRead[METRICS_READBACK_FRAMES];       // Slot holds the active-tile count
+    int denseSweeps[METRICS_READBACK_FRAMES];     // solveDenseSweeps of the frame, -1: no solve counter
+    int sweeps[METRICS_READBACK_FRAMES];          // pressureIterations of the frame
+    int next;
+} CounterReadback;
+
+// GPU texture fill (clears and generated impulses), one per image format
+typedef struct {
+    ComputePipeline pipeline;
+    GLenum format;
+    GLint sizeLoc;
+    GLint valueLoc;
+    GLint spotRectLoc;
+    GLint spotValueLoc;
+} FillPipeline;
+
 // Shader programs
-GLuint advectUProgram;           // Advect u-velocity (513x512)
-GLuint advectVProgram;           // Advect v-velocity (512x513)
-GLuint advectDensityProgram;
-GLuint divergenceProgram;
-GLuint pressureProgram;
-GLuint gradientSubtractUProgram; // Gradient subtraction for u (513x512)
-GLuint gradientSubtractVProgram; // Gradient subtraction for v (512x513)
-GLuint addForceUProgram;         // Force addition for u (513x512)
-GLuint addForceVProgram;         // Force addition for v (512x513)
-GLuint addForceDensityProgram;   // Force addition for density (512x512)
+ComputePipeline advectUPipeline;           // Advect u-velocity (513x512)
+ComputePipeline advectVPipeline;           // Advect v-velocity (512x513)
+ComputePipeline advectDensityPipeline;
+ComputePipeline advectVelocityPipeline;    // Fused u and v advection (fusedVelocityAdvection)
+// Builds of the advection kernels for the MacCormack/BFECC stages
+// (shaders/include/advection.glsl), indexed by ADVECT_STAGE_*
+#define ADVECT_STAGE_PREDICT     0
+#define ADVECT_STAGE_MACCORMACK  1
+#define ADVECT_STAGE_BFECC_ERROR 2
+#define ADVECT_STAGE_BFECC_FINAL 3
+#define ADVECT_STAGES            4
+static const char* advectStageDefines[ADVECT_STAGES] = {
+    "#define ADVECT_PREDICT\n", "#define ADVECT_MACCORMACK\n", "#define ADVECT_BFECC_ERROR\n",
+    "#define ADVECT_BFECC_FINAL\n",
+};
+ComputePipeline advectUStagePipelines[ADVECT_STAGES];
+ComputePipeline advectVStagePipelines[ADVECT_STAGES];
+ComputePipeline advectDensityStagePipelines[ADVECT_STAGES];
+ComputePipeline advectVelocityStagePipelines[ADVECT_STAGES];
+ComputePipeline divergencePipeline;        // Tiled and region passes
+ComputePipeline divergenceDensePipeline;   // Full-grid passes, tuned work group
+ComputePipeline pressurePipeline;          // Boundary build: outer tile ring
+ComputePipeline pressureInteriorPipeline;  // INTERIOR build: interior tiles, no bounds tests
+ComputePipeline pressureDensePipeline;     // INTERIOR build for plain full sweeps, tuned work group
+ComputePipeline gradientSubtractUPipeline; // Gradient subtraction for u (513x512), boundary
+ComputePipeline gradientSubtractVPipeline; // Gradient subtraction for v (512x513), boundary
+ComputePipeline gradientSubtractUInteriorPipeline;
+ComputePipeline gradientSubtractVInteriorPipeline;
+ComputePipeline addForceUPipeline;         // Force addition for u (513x512)
+ComputePipeline addForceVPipeline;         // Force addition for v (512x513)
+ComputePipeline addForceDensityPipeline;   // Force addition for density (512x512)
+ComputePipeline divergenceStatsPipeline;
+ComputePipeline statsSummaryPipeline;      // Histogram -> overlay summary
+ComputePipeline flowMetricsPipeline;       // Per-tile partial metrics
+ComputePipeline flowMetricsReducePipeline; // Partials -> FlowMetrics
+ComputePipeline tileMaskPipeline;          // Per-tile activity
+ComputePipeline tileCompactPipeline;       // Dilate + compact into tile lists
+ComputePipeline tileClearPipeline;         // Zero retiring tiles
+ComputePipeline pressureCompactPipeline;   // Active-set list for the pressure solve
+FillPipeline fillR32FPipeline;             // Clears u, v and pressure
+FillPipeline fillRGBA32FPipeline;          // Clears density
 GLuint renderProgram;
-GLuint divergenceStatsProgram;
 GLuint textProgram;
+GLuint statsOverlayProgram;
+GLuint statsHistoryProgram;
+
+// Uniforms that still change between draws/dispatches within a frame
+GLint pressureRedPassLoc;
+GLint pressureTrackResidualLoc;
+GLint pressureInteriorRedPassLoc;
+GLint pressureInteriorTrackResidualLoc;
+GLint pressureDenseRedPassLoc;
+GLint pressureCompactSweepsLoc;
+GLint renderDisplayModeLoc;
+GLint renderDensityBlendLoc;
+
+// Per-frame uniform buffer
+FrameParams frameParams;
+GLuint frameParamsBuffer;
+
+// Splats queued by the mouse callback, uploaded and applied once per frame
+Splat splatQueue[MAX_SPLATS];
+int numQueuedSplats = 0;
+GLuint splatBuffer;
+
+// Host->device bytes issued by the last simulate() (HUD). Simulation state is
+// cleared and seeded on the GPU, so steady state only uploads FrameParams.
+size_t hostUploadBytes = 0;
+
+// HUD text: glyphs queued by hudText() during the frame, drawn by hudFlush()
+#define HUD_MAX_GLYPHS 4096  // Per frame; further glyphs are dropped
+#define HUD_FRAMES 3         // Buffer slices in flight
+
+// One glyph instance (vertex attributes of text.vert)
+typedef struct {
+    float x, y;          // Top-left corner in window pixels
+    float scale;         // Size in 8x8 font cells
+    uint32_t glyph;      // Font cell (character - 32)
+    uint32_t color;      // RGBA8
+} HudGlyph;
+
+typedef struct {
+    GLuint vao, vbo;             // HUD_FRAMES slices of HUD_MAX_GLYPHS glyphs
+    HudGlyph* mapped;            // Persistent mapping of all slices, NULL without buffer storage
+    HudGlyph staging[HUD_MAX_GLYPHS];  // This frame's glyphs when not mapped
+    GLsync fences[HUD_FRAMES];   // Last draw from each slice
+    int slice;
+    int count;                   // Glyphs queued this frame
+} HudBatch;
 
-// Text rendering
 GLuint fontTexture;
-GLuint textVAO, textVBO;
+HudBatch hud;
 
-// Stats buffer
+// Stats buffers (diagnostics only)
 GLuint statsBuffer;
+GLuint statsSummaryBuffer;
+GLuint statsHistoryBuffer;        // Kept while diagnostics are off, freed at exit
+StatsHistoryEntry statsHistoryEntries[HISTORY_FRAMES];  // Same slots as the GPU ring
+unsigned int statsHistoryWritten = 0;                    // Entries appended so far
+
+// Flow metrics, reduced every frame and read back a few frames late
+int flowMetricsEnabled = 1;
+int showHotSpots = 0;              // Mark the worst-divergence cells (needs the metrics)
+GLuint flowPartialsBuffer;
+GLuint flowMetricsBuffer;
+MetricsReadback metricsReadback;
+CounterReadback counterReadback;
+FlowMetrics flowMetrics;           // Latest values to arrive
+unsigned int flowMetricsFrame;     // simFrame they measured
+float flowMetricsDt;               // dt of that frame (CFL number)
+int flowMetricsValid = 0;
+
+// Timestep: the frame delta as one step, whole steps of 1/simStepRate taken from
+// an accumulator, or the frame delta split so that max |u| * dt stays under
+// targetCfl. At most maxSubsteps per displayed frame in either of the last two.
+#define TIMESTEP_FRAME 0
+#define TIMESTEP_FIXED 1
+#define TIMESTEP_CFL   2
+int timestepMode = TIMESTEP_FRAME;
+float simStepRate = 120.0f;        // Steps per second in fixed mode
+float targetCfl = 1.0f;            // Cells a backtrace may cross per step in CFL mode
+int maxSubsteps = 4;               // Fixed: steps beyond this are dropped; CFL: the target gives
+int interpolateRender = 1;         // Blend the last two dye states by the leftover time
+double stepAccumulator = 0.0;      // Banked time not yet stepped, seconds
+double stepAccumulatorTime = 0.0;  // glfwGetTime() of the last deposit
+float densityBlend = 1.0f;         // Weight of the newest dye state in render()
+int previousDensityValid = 0;      // densityTex[1 - currentDensity] is the step before
+int substepsLastFrame = 0;
+unsigned int droppedSteps = 0;
+float cflSpeedEstimate = 0.0f;     // Speed the last CFL split was made for, cells/s
+
+// Upper bound on the speed each step's splats added, by simFrame, for the steps
+// the lagging metrics have not measured yet
+#define SPLAT_SPEED_HISTORY 16
+float splatSpeedHistory[SPLAT_SPEED_HISTORY];
+
+// What the HUD shows about the simulation, copied when a frame is captured so
+// the window thread never reads simulation globals the other thread is writing
+typedef struct {
+    unsigned int simFrame;
+    int displayMode;
+    int pressureIterations;
+    float pressureOmega;
+    int diagnosticsLevel;
+    int diagnosticsInterval;
+    size_t hostUploadBytes;
+    int sparseTiles;
+    int activeTileCount;
+    int activeSetSolve;
+    float solveSweptFraction;
+    int debugTestMode;
+    int advectionScheme;
+    int velocityBacktraceOrder;
+    int densityBacktraceOrder;
+    int fusedVelocityAdvection;
+    int advectHalo;
+    int timestepMode;
+    float stepDt;                  // dt of the newest step
+    float stepBlend;               // densityBlend of the newest frame
+    double stepBlendTime;          // glfwGetTime() stepBlend holds for
+    float simStepRate;
+    float targetCfl;
+    float cflSpeedEstimate;
+    int substeps;
+    unsigned int droppedSteps;
+    int showConvergence;
+    int showHistory;
+    int showHotSpots;
+    unsigned int statsHistoryWritten;
+    int flowMetricsShown;          // Enabled and arrived
+    FlowMetrics flowMetrics;
+    unsigned int flowMetricsFrame;
+    float flowMetricsDt;
+    float simStepsPerSecond;       // Simulation thread only (0 otherwise)
+    unsigned int inputDropped;
+} SimStatus;
+
+// Everything render() and the HUD draw from. Single-threaded, it names the live
+// simulation objects. With the simulation thread, each of the PRESENT_SLOTS owns
+// copies that the simulation thread fills and fences (ready) and the window
+// thread fences once its draws are queued (released); the two swap slots through
+// readyPresentSlot (a triple buffer), so neither waits on the other's frame.
+typedef struct {
+    GLuint density;
+    GLuint previousDensity;        // Dye one step back for the blend, or 0
+    float densityBlend;
+    GLuint densityBefore;          // Slot copy of the dye one step back
+    GLuint u, v;
+    GLuint field;                  // Divergence or pressure, by view
+    GLuint stats, statsSummary;    // Histogram and summary for the overlay
+    GLuint statsHistory;
+    int hasStats, hasHistory;      // Overlay buffers filled for this frame
+    int published;                 // Holds a frame at all
+    GLsync ready;
+    GLsync released;
+    SimStatus status;
+} PresentSlot;
+
+#define PRESENT_SLOTS 3
+#define PRESENT_INDEX 3            // Slot bits of readyPresentSlot
+#define PRESENT_NEW   4            // Set while the ready slot has not been taken
+PresentSlot presentSlots[PRESENT_SLOTS];
+int simPresentSlot = 0;            // Owned by the simulation thread
+int mainPresentSlot = 2;           // Owned by the window thread
+volatile long readyPresentSlot = 1;
+
+// Input from the GLFW callbacks to the simulation thread: a single-producer,
+// single-consumer ring. Only the window thread advances head, only the
+// simulation thread advances tail; a full ring drops the event.
+#define INPUT_KEY   0
+#define INPUT_SPLAT 1
+typedef struct {
+    int type;
+    int key;                       // INPUT_KEY: GLFW key (presses only)
+    float segment[4];              // INPUT_SPLAT: x0, y0, x1, y1 as for queueSplat()
+} InputEvent;
+
+#define INPUT_QUEUE_SIZE 1024      // Power of two
+typedef struct {
+    InputEvent events[INPUT_QUEUE_SIZE];
+    volatile long head;
+    volatile long tail;
+    volatile long dropped;         // Written by the window thread, read for the HUD
+} InputQueue;
+
+// Simulation thread: steps on its own clock in a second context that shares
+// objects with the window's. Off with --single-thread.
+int simThreadEnabled = 1;
+int simThreadRunning = 0;
+GLFWwindow* simWindow;
+ThreadHandle simThread;
+volatile long simThreadStop = 0;
+InputQueue inputQueue;
+float simStepsPerSecond = 0.0f;
+
+// Active-tile lists and flags
+GLuint tileListBuffer;
+GLuint tileFlagsBuffer;
+int tileStateValid = 0;    // Cleared whenever a frame runs without the tile lists
+int activeTileCount = -1;  // Read back for the HUD while diagnostics are on
+
+// Pressure active set
+GLuint solveListBuffer;
+GLuint solveResidualBuffer;
+int solveDenseSweeps = 0;   // Full-grid sweeps in the last solve (the list counts the rest)
+float solveSweptFraction = -1.0f;  // Tile sweeps done / full solve, read back for the HUD
 
 // Textures for simulation
 GLuint uVelocityTex[2];  // R32F, u-component (horizontal velocity)
 GLuint vVelocityTex[2];  // R32F, v-component (vertical velocity)
-GLuint pressureTex[2];
+GLuint densityTex[2];
+
+// Per-frame intermediates, drawn from the transient pool each frame
+GLuint pressureTex;
 GLuint divergenceTex;
 GLuint postDivergenceTex;
-GLuint densityTex[2];
+
+// Transient texture pool keyed by format and size. A texture released earlier
+// in the frame is handed to the next request with the same key, so fields
+// with non-overlapping lifetimes (e.g. pressure and post-divergence) share
+// memory. Entries unused for a whole frame are freed.
+#define TRANSIENT_POOL_SIZE 16
+#define TRANSIENT_MAX_USERS 4
+
+typedef struct {
+    GLuint tex;
+    GLenum format;
+    int width, height;
+    GLint filter;
+    int inUse;
+    int uses;                                // Acquisitions this frame
+    const char* users[TRANSIENT_MAX_USERS];  // For the memory report
+} TransientTexture;
+
+TransientTexture transientPool[TRANSIENT_POOL_SIZE];
 
 // Stats timing
 double lastStatsPrintTime = 0.0;
@@ -70,40 +606,41 @@ GLuint quadVAO, quadVBO;
 
 // Simulation state
 int currentVel = 0;
-int currentPressure = 0;
 int currentDensity = 0;
 
-// Clear texture data buffers (allocated once)
-float* clearDataR = NULL;       // For 512x512 textures
-float* clearDataRG = NULL;      // For 512x512 textures
-float* clearDataRGBA = NULL;    // For 512x512 textures
-float* clearDataU = NULL;       // For 513x512 u-velocity texture
-float* clearDataV = NULL;       // For 512x513 v-velocity texture
-
 // Mouse state
 double lastMouseX = 0, lastMouseY = 0;
 int mousePressed = 0;
 
-// Pending force to apply (set by callback, applied in simulate)
-int hasPendingForce = 0;
-float pendingForceX = 0, pendingForceY = 0;
-float pendingForceDX = 0, pendingForceDY = 0;
-
 // Debug visualization
 // displayMode: 0=density, 1=velocity, 2=pre-divergence, 3=post-divergence
 int displayMode = 0;
 int showConvergence = 0;
+int showHistory = 0;
 int debugTestMode = 0;  // Fixed impulse test mode for pressure solver debugging
 
+// Diagnostics level: decides whether the visualization-only passes (post-projection
+// divergence, 2D histogram) run, and whether their resources are allocated at all
+#define DIAGNOSTICS_OFF     0  // Production: advection, forcing and projection only
+#define DIAGNOSTICS_SAMPLED 1  // Every diagnosticsInterval frames
+#define DIAGNOSTICS_FULL    2  // Every frame
+int diagnosticsLevel = DIAGNOSTICS_OFF;
+int diagnosticsInterval = 30;
+unsigned int simFrame = 0;
+
 // Function prototypes
 char* loadShaderSource(const char* filename);
 GLuint createComputeShader(const char* filename);
+GLuint createComputeShaderVariant(const char* filename, const char* defines);
+void submitComputePipeline(ComputePipeline* p, const char* filename, const char* defines);
+int finishComputePipelines(void);
 GLuint createRenderProgram(const char* vertFile, const char* fragFile);
 void createTextures(void);
 void createQuad(void);
 void simulate(float dt);
-void render(void);
-void addForce(float x, float y, float dx, float dy);
+void advanceSimulation(float frameDt);
+float estimateMaxSpeed(void);
+void render(const PresentSlot* frame);
 
 char* loadShaderSource(const char* filename) {
     FILE* file = fopen(filename, "rb");
@@ -124,44 +661,395 @@ char* loadShaderSource(const char* filename) {
     return source;
 }
 
-GLuint createComputeShader(const char* filename) {
+static void appendShaderText(ShaderSource* s, const char* text, size_t length) {
+    if (s->length + length + 1 > s->capacity) {
+        s->capacity = 2 * (s->length + length + 1);
+        s->text = (char*)realloc(s->text, s->capacity);
+    }
+    memcpy(s->text + s->length, text, length);
+    s->length += length;
+    s->text[s->length] = '\0';
+}
+
+// Append filename to s with each #include "name" line replaced by that file,
+// resolved relative to the including file's directory. A file is expanded at
+// most once per shader (later includes of it are dropped), so includes need no
+// guards. #line directives keep compiler messages on the right file and line.
+static int expandShaderFile(ShaderSource* s, const char* filename) {
+    if (s->fileCount == SHADER_MAX_FILES) {
+        fprintf(stderr, "Too many shader includes (%s)\n", filename);
+        return 0;
+    }
     char* source = loadShaderSource(filename);
     if (!source) return 0;
+    int index = s->fileCount++;
+    snprintf(s->files[index], sizeof(s->files[index]), "%s", filename);
+
+    int ok = 1;
+    int line = 1;
+    for (const char* p = source; *p && ok; line++) {
+        const char* end = strchr(p, '\n');
+        end = end ? end + 1 : p + strlen(p);
+        const char* q = p + strspn(p, " \t");
+
+        if (strncmp(q, "#include", 8) != 0) {
+            appendShaderText(s, p, end - p);
+            p = end;
+            continue;
+        }
 
-    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
-    glShaderSource(shader, 1, (const char**)&source, NULL);
-    glCompileShader(shader);
+        const char* open = memchr(q, '"', end - q);
+        const char* close = open ? memchr(open + 1, '"', end - open - 1) : NULL;
+        if (!close) {
+            fprintf(stderr, "%s:%d: expected #include \"file\"\n", filename, line);
+            ok = 0;
+            break;
+        }
+        const char* slash = strrchr(filename, '/');
+        int dirLength = slash ? (int)(slash - filename + 1) : 0;
+        char path[256];
+        snprintf(path, sizeof(path), "%.*s%.*s", dirLength, filename, (int)(close - open - 1), open + 1);
+
+        int seen = 0;
+        for (int i = 0; i < s->fileCount; i++) seen = seen || strcmp(s->files[i], path) == 0;
+        char directive[64];
+        if (!seen) {
+            snprintf(directive, sizeof(directive), "#line 1 %d\n", s->fileCount);
+            appendShaderText(s, directive, strlen(directive));
+            ok = expandShaderFile(s, path);
+            if (!ok) fprintf(stderr, "  included from %s:%d\n", filename, line);
+        }
+        snprintf(directive, sizeof(directive), "\n#line %d %d\n", line + 1, index);
+        appendShaderText(s, directive, strlen(directive));
+        p = end;
+    }
 
-    int success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char log[512];
-        glGetShaderInfoLog(shader, 512, NULL, log);
-        fprintf(stderr, "Compute shader compilation failed (%s):\n%s\n", filename, log);
-        free(source);
-        return 0;
+    free(source);
+    return ok;
+}
+
+static const char* imageFormatQualifier(GLenum format) {
+    switch (format) {
+        case GL_RGBA32F: return "rgba32f";
+        case GL_RGBA16F: return "rgba16f";
+        case GL_R32F:    return "r32f";
+        case GL_R16F:    return "r16f";
+        default:         return "unknown_format";
     }
+}
 
-    GLuint program = glCreateProgram();
-    glAttachShader(program, shader);
-    glLinkProgram(program);
+// The #define block every compute shader is compiled with
+void shaderConfigDefines(const ShaderConfig* c, char* out, size_t size) {
+    snprintf(out, size,
+             "#define GRID_WIDTH %d\n"
+             "#define GRID_HEIGHT %d\n"
+             "#define TILE_SIZE %d\n"
+             "#define VELOCITY_FORMAT %s\n"
+             "#define DENSITY_FORMAT %s\n"
+             "#define ADVECT_HALO_MAX %d\n",
+             c->gridWidth, c->gridHeight, TILE_SIZE,
+             imageFormatQualifier(VELOCITY_FORMAT), imageFormatQualifier(DENSITY_FORMAT),
+             ADVECT_HALO_MAX);
+}
 
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success) {
-        char log[512];
-        glGetProgramInfoLog(program, 512, NULL, log);
-        fprintf(stderr, "Program linking failed (%s):\n%s\n", filename, log);
+// ============================================================================
+// Program builds
+// ============================================================================
+// Compute programs are built in two steps so the driver can work on all of them
+// at once: submitComputePipeline() starts a build (glCompileShader and
+// glLinkProgram, no status queries, which would block), finishComputePipelines()
+// waits for every submitted build and resolves the pipelines. With
+// GL_KHR_parallel_shader_compile the driver compiles on its own threads.
+//
+// Linked programs are kept in PROGRAM_CACHE_FILE (glGetProgramBinary), keyed by
+// a hash of the driver strings and the complete shader text (includes, defines),
+// so any source or config change misses. A hit is loaded with glProgramBinary
+// and skips compilation; a binary the driver rejects is rebuilt from source.
+
+// GL_KHR_parallel_shader_compile (not in the bundled glad)
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+#define PROGRAM_CACHE_FILE "programs.cache"
+#define PROGRAM_CACHE_MAGIC "SFPB"
+#define PROGRAM_CACHE_MAX 64   // Entries kept; the least recently used is dropped
+#define PROGRAM_BUILD_MAX 48   // Builds in flight between submit and finish
+
+typedef struct {
+    uint64_t key;        // Driver + shader text hash
+    uint32_t format;     // Binary format from glGetProgramBinary
+    uint32_t length;
+    void* data;
+    unsigned lastUse;
+} ProgramCacheEntry;
+
+typedef struct {
+    ComputePipeline* pipeline;
+    GLuint shader;       // 0 if loaded from the cache (or the source failed to load)
+    uint64_t key;
+    ShaderSource source; // Only the file names are kept, for compiler messages
+} ProgramBuild;
+
+ProgramCacheEntry programCache[PROGRAM_CACHE_MAX];
+int programCacheCount = 0;
+int programCacheState = 0;  // 0 = not loaded yet, 1 = in use, -1 = no binary formats
+int programCacheDirty = 0;
+unsigned programCacheClock = 0;
+uint64_t driverKey;
+
+ProgramBuild programBuilds[PROGRAM_BUILD_MAX];
+int programBuildCount = 0;
+int programsCompiled = 0;   // Totals since startup, for the startup report
+int programsFromCache = 0;
+
+// FNV-1a
+static uint64_t hashBytes(uint64_t h, const void* data, size_t length) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < length; i++) h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+// Ask the driver to compile on its own threads; returns 1 if it can
+int enableParallelShaderCompile(void) {
+    const char* name = NULL;
+    if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) name = "glMaxShaderCompilerThreadsKHR";
+    else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile")) name = "glMaxShaderCompilerThreadsARB";
+    if (!name) return 0;
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads =
+        (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress(name);
+    if (!maxShaderCompilerThreads) return 0;
+    maxShaderCompilerThreads(0xFFFFFFFFu);  // As many threads as the implementation wants
+    return 1;
+}
+
+// Read PROGRAM_CACHE_FILE; a file written by another driver is ignored (and
+// replaced on the next save)
+static void loadProgramCache(void) {
+    const char* driver[3] = {(const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER),
+                             (const char*)glGetString(GL_VERSION)};
+    driverKey = 14695981039346656037ull;
+    for (int i = 0; i < 3; i++) driverKey = hashBytes(driverKey, driver[i], strlen(driver[i]) + 1);
+
+    GLint numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    programCacheState = numFormats > 0 ? 1 : -1;
+    if (programCacheState < 0) return;
+
+    FILE* file = fopen(PROGRAM_CACHE_FILE, "rb");
+    if (!file) return;
+    char magic[4];
+    uint64_t fileDriverKey;
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, PROGRAM_CACHE_MAGIC, 4) != 0 ||
+        fread(&fileDriverKey, sizeof(fileDriverKey), 1, file) != 1 || fileDriverKey != driverKey) {
+        fclose(file);
+        return;
     }
+    ProgramCacheEntry e = {0};
+    while (programCacheCount < PROGRAM_CACHE_MAX && fread(&e.key, sizeof(e.key), 1, file) == 1 &&
+           fread(&e.format, sizeof(e.format), 1, file) == 1 && fread(&e.length, sizeof(e.length), 1, file) == 1) {
+        if (e.length == 0 || e.length > (64u << 20)) break;  // Damaged file
+        e.data = malloc(e.length);
+        if (fread(e.data, 1, e.length, file) != e.length) {
+            free(e.data);
+            break;
+        }
+        programCache[programCacheCount++] = e;
+    }
+    fclose(file);
+}
 
-    glDeleteShader(shader);
-    free(source);
-    return program;
+static void saveProgramCache(void) {
+    programCacheDirty = 0;
+    FILE* file = fopen(PROGRAM_CACHE_FILE, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to write %s\n", PROGRAM_CACHE_FILE);
+        return;
+    }
+    fwrite(PROGRAM_CACHE_MAGIC, 1, 4, file);
+    fwrite(&driverKey, sizeof(driverKey), 1, file);
+    for (int i = 0; i < programCacheCount; i++) {
+        const ProgramCacheEntry* e = &programCache[i];
+        fwrite(&e->key, sizeof(e->key), 1, file);
+        fwrite(&e->format, sizeof(e->format), 1, file);
+        fwrite(&e->length, sizeof(e->length), 1, file);
+        fwrite(e->data, 1, e->length, file);
+    }
+    fclose(file);
 }
 
+static ProgramCacheEntry* findProgramCache(uint64_t key) {
+    for (int i = 0; i < programCacheCount; i++) {
+        if (programCache[i].key == key) {
+            programCache[i].lastUse = ++programCacheClock;
+            return &programCache[i];
+        }
+    }
+    return NULL;
+}
+
+// Add the binary of a freshly linked program, replacing the least recently used entry when full
+static void storeProgramBinary(uint64_t key, GLuint program) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    ProgramCacheEntry e = {key, 0, 0, malloc(length), ++programCacheClock};
+    GLsizei written = 0;
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &written, &format, e.data);
+    if (written <= 0) {
+        free(e.data);
+        return;
+    }
+    e.format = format;
+    e.length = (uint32_t)written;
+
+    int slot = programCacheCount;
+    if (slot == PROGRAM_CACHE_MAX) {
+        slot = 0;
+        for (int i = 1; i < PROGRAM_CACHE_MAX; i++) {
+            if (programCache[i].lastUse < programCache[slot].lastUse) slot = i;
+        }
+        free(programCache[slot].data);
+    } else {
+        programCacheCount++;
+    }
+    programCache[slot] = e;
+    programCacheDirty = 1;
+}
+
+// Start building filename into p, with #include expanded and the shaderConfig
+// defines and the variant's own (e.g. "#define INTERIOR\n") inserted after the
+// #version line. p is filled in by finishComputePipelines(); until then only
+// p->program is set.
+void submitComputePipeline(ComputePipeline* p, const char* filename, const char* defines) {
+    memset(p, 0, sizeof(*p));
+    if (programBuildCount == PROGRAM_BUILD_MAX) {
+        fprintf(stderr, "Too many programs in one build (%s)\n", filename);
+        return;
+    }
+    if (programCacheState == 0) loadProgramCache();
+
+    ProgramBuild* b = &programBuilds[programBuildCount++];
+    memset(b, 0, sizeof(*b));
+    b->pipeline = p;
+    if (!expandShaderFile(&b->source, filename)) {
+        free(b->source.text);
+        return;
+    }
+
+    char configDefines[512];
+    shaderConfigDefines(&shaderConfig, configDefines, sizeof(configDefines));
+
+    const char* text = b->source.text;
+    const char* body = strchr(text, '\n');
+    body = body ? body + 1 : text + b->source.length;
+    const char* parts[5] = {text, configDefines, defines ? defines : "", "#line 2 0\n", body};
+    GLint lengths[5] = {(GLint)(body - text), (GLint)strlen(parts[1]), (GLint)strlen(parts[2]),
+                        (GLint)strlen(parts[3]), (GLint)strlen(body)};
+
+    b->key = driverKey;
+    for (int i = 0; i < 5; i++) b->key = hashBytes(b->key, parts[i], lengths[i]);
+
+    p->program = glCreateProgram();
+    ProgramCacheEntry* cached = programCacheState > 0 ? findProgramCache(b->key) : NULL;
+    if (cached) {
+        GLint linked = 0;
+        glProgramBinary(p->program, cached->format, cached->data, (GLsizei)cached->length);
+        glGetProgramiv(p->program, GL_LINK_STATUS, &linked);
+        if (linked) {
+            programsFromCache++;
+            free(b->source.text);
+            return;
+        }
+    }
+
+    b->shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(b->shader, 5, parts, lengths);
+    glCompileShader(b->shader);
+    glAttachShader(p->program, b->shader);
+    if (programCacheState > 0) glProgramParameteri(p->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(p->program);
+    programsCompiled++;
+    free(b->source.text);
+}
+
+// Wait for every submitted build, report errors, cache the new binaries and
+// resolve the pipelines. Failed pipelines are left with program 0. Returns 1
+// if all builds succeeded.
+int finishComputePipelines(void) {
+    int ok = 1;
+    for (int i = 0; i < programBuildCount; i++) {
+        ProgramBuild* b = &programBuilds[i];
+        ComputePipeline* p = b->pipeline;
+        if (b->shader) {
+            GLint success;
+            glGetShaderiv(b->shader, GL_COMPILE_STATUS, &success);
+            if (!success) {
+                char log[1024];
+                glGetShaderInfoLog(b->shader, sizeof(log), NULL, log);
+                fprintf(stderr, "Compute shader compilation failed (%s):\n%s\n", b->source.files[0], log);
+                for (int j = 1; j < b->source.fileCount; j++) {
+                    fprintf(stderr, "  source %d: %s\n", j, b->source.files[j]);
+                }
+            } else {
+                glGetProgramiv(p->program, GL_LINK_STATUS, &success);
+                if (!success) {
+                    char log[512];
+                    glGetProgramInfoLog(p->program, sizeof(log), NULL, log);
+                    fprintf(stderr, "Program linking failed (%s):\n%s\n", b->source.files[0], log);
+                }
+            }
+            glDeleteShader(b->shader);
+            if (success && programCacheState > 0) {
+                storeProgramBinary(b->key, p->program);
+            } else if (!success) {
+                glDeleteProgram(p->program);
+                p->program = 0;
+            }
+        }
+        if (!p->program) {
+            ok = 0;
+            continue;
+        }
+        glGetProgramiv(p->program, GL_COMPUTE_WORK_GROUP_SIZE, p->localSize);
+        p->originLoc = glGetUniformLocation(p->program, "dispatchOrigin");
+        p->tileDispatchLoc = glGetUniformLocation(p->program, "tileDispatch");
+        p->ringDispatchLoc = glGetUniformLocation(p->program, "ringDispatch");
+    }
+    programBuildCount = 0;
+    if (programCacheDirty) saveProgramCache();
+    return ok;
+}
+
+void freeProgramCache(void) {
+    for (int i = 0; i < programCacheCount; i++) free(programCache[i].data);
+    programCacheCount = 0;
+    programCacheState = 0;
+}
+
+GLuint createComputeShader(const char* filename) {
+    return createComputeShaderVariant(filename, NULL);
+}
+
+// Build one program on its own (submit + finish)
+GLuint createComputeShaderVariant(const char* filename, const char* defines) {
+    ComputePipeline p;
+    submitComputePipeline(&p, filename, defines);
+    finishComputePipelines();
+    return p.program;
+}
+
+// Vertex + fragment program; #include is expanded, but no defines are added
 GLuint createRenderProgram(const char* vertFile, const char* fragFile) {
-    char* vertSource = loadShaderSource(vertFile);
-    char* fragSource = loadShaderSource(fragFile);
-    if (!vertSource || !fragSource) return 0;
+    ShaderSource vert = {0};
+    ShaderSource frag = {0};
+    if (!expandShaderFile(&vert, vertFile) || !expandShaderFile(&frag, fragFile)) {
+        free(vert.text);
+        free(frag.text);
+        return 0;
+    }
+    char* vertSource = vert.text;
+    char* fragSource = frag.text;
 
     GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertShader, 1, (const char**)&vertSource, NULL);
@@ -206,39 +1094,767 @@ GLuint createRenderProgram(const char* vertFile, const char* fragFile) {
     return program;
 }
 
-void initClearData(void) {
-    // Allocate zero-filled buffers for clearing textures
-    clearDataR = (float*)calloc(SIM_WIDTH * SIM_HEIGHT, sizeof(float));
-    clearDataRG = (float*)calloc(SIM_WIDTH * SIM_HEIGHT * 2, sizeof(float));
-    clearDataRGBA = (float*)calloc(SIM_WIDTH * SIM_HEIGHT * 4, sizeof(float));
-    // Separate buffers for staggered MAC grid dimensions
-    clearDataU = (float*)calloc(U_WIDTH * U_HEIGHT, sizeof(float));  // 513x512
-    clearDataV = (float*)calloc(V_WIDTH * V_HEIGHT, sizeof(float));  // 512x513
+// Dispatch enough work groups to cover a width x height domain
+void dispatchPipeline(const ComputePipeline* p, int width, int height) {
+    glDispatchCompute((width + p->localSize[0] - 1) / p->localSize[0],
+                      (height + p->localSize[1] - 1) / p->localSize[1], 1);
 }
 
-void clearTextureR(GLuint tex) {
-    glBindTexture(GL_TEXTURE_2D, tex);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SIM_WIDTH, SIM_HEIGHT, GL_RED, GL_FLOAT, clearDataR);
+// Interior/boundary split of a stencil kernel over a width x height field. The
+// field is covered by TILE_SIZE tiles; the interior tiles (all but the outer
+// ring) are whole and have every neighbour inside the field, so they run the
+// INTERIOR build without bounds tests. The general build runs only on the ring
+// (one work group per tile) and applies the boundary condition. Returns 0 if
+// the field is too small to have interior tiles.
+int interiorRect(int width, int height, int rect[4]) {
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    rect[0] = TILE_SIZE;
+    rect[1] = TILE_SIZE;
+    rect[2] = (tilesX - 1) * TILE_SIZE;
+    rect[3] = (tilesY - 1) * TILE_SIZE;
+    return tilesX > 2 && tilesY > 2;
 }
 
-void clearTextureRG(GLuint tex) {
-    glBindTexture(GL_TEXTURE_2D, tex);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SIM_WIDTH, SIM_HEIGHT, GL_RG, GL_FLOAT, clearDataRG);
+int ringTileCount(int width, int height) {
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    int innerX = tilesX > 2 ? tilesX - 2 : 0;
+    int innerY = tilesY > 2 ? tilesY - 2 : 0;
+    return tilesX * tilesY - innerX * innerY;
+}
+
+// Both expect the pipeline's program to be bound
+void dispatchInterior(const ComputePipeline* p, int width, int height) {
+    int rect[4];
+    if (!interiorRect(width, height, rect)) return;
+    glUniform2i(p->originLoc, rect[0], rect[1]);
+    dispatchPipeline(p, rect[2] - rect[0], rect[3] - rect[1]);
+}
+
+void dispatchRing(const ComputePipeline* p, int width, int height) {
+    glUniform1i(p->ringDispatchLoc, 1);
+    glDispatchCompute(ringTileCount(width, height), 1, 1);
+}
+
+// Whether an x by y work group can run kernel k on this device and grid
+int workGroupFits(int k, int x, int y) {
+    GLint maxInvocations, maxX, maxY;
+    glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &maxInvocations);
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 0, &maxX);
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 1, &maxY);
+    if (x < 1 || y < 1 || x > maxX || y > maxY || x * y > maxInvocations) return 0;
+    if (!tunedKernels[k].exact) return 1;
+    int rect[4];
+    if (!interiorRect(shaderConfig.gridWidth, shaderConfig.gridHeight, rect)) return 1;
+    return (rect[2] - rect[0]) % x == 0 && (rect[3] - rect[1]) % y == 0;
+}
+
+// Build a tuned kernel with its current work group size as LOCAL_SIZE_X/Y
+void submitTunedPipeline(ComputePipeline* p, int k, const char* filename, const char* defines) {
+    char allDefines[256];
+    snprintf(allDefines, sizeof(allDefines), "#define LOCAL_SIZE_X %d\n#define LOCAL_SIZE_Y %d\n%s",
+             tunedKernels[k].localSize[0], tunedKernels[k].localSize[1], defines ? defines : "");
+    submitComputePipeline(p, filename, allDefines);
+}
+
+// Reset every tuned kernel to the default size, then apply the cache entries
+// for this renderer and grid. Returns the number of entries applied.
+int loadWorkGroupCache(const char* path) {
+    for (int k = 0; k < TUNE_COUNT; k++) {
+        tunedKernels[k].localSize[0] = shaderConfig.localSizeX;
+        tunedKernels[k].localSize[1] = shaderConfig.localSizeY;
+    }
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    int sameRenderer = 0;
+    int applied = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strncmp(line, "renderer ", 9) == 0) {
+            sameRenderer = strcmp(line + 9, renderer) == 0;
+            continue;
+        }
+        char name[64];
+        int width, height, x, y;
+        if (!sameRenderer || sscanf(line, "%63s %d %d %d %d", name, &width, &height, &x, &y) != 5) continue;
+        if (width != shaderConfig.gridWidth || height != shaderConfig.gridHeight) continue;
+        for (int k = 0; k < TUNE_COUNT; k++) {
+            if (strcmp(name, tunedKernels[k].name) == 0 && workGroupFits(k, x, y)) {
+                tunedKernels[k].localSize[0] = x;
+                tunedKernels[k].localSize[1] = y;
+                applied++;
+            }
+        }
+    }
+    fclose(file);
+    return applied;
+}
+
+// Write the current sizes for this grid. Entries for other grids are kept if
+// they were measured on the same renderer; the cache holds one renderer.
+int saveWorkGroupCache(const char* path) {
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    char kept[64][256];
+    int numKept = 0;
+
+    FILE* file = fopen(path, "r");
+    if (file) {
+        int sameRenderer = 0;
+        char line[256];
+        while (fgets(line, sizeof(line), file)) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (strncmp(line, "renderer ", 9) == 0) {
+                sameRenderer = strcmp(line + 9, renderer) == 0;
+                continue;
+            }
+            char name[64];
+            int width, height, x, y;
+            if (sameRenderer && numKept < 64 &&
+                sscanf(line, "%63s %d %d %d %d", name, &width, &height, &x, &y) == 5 &&
+                (width != shaderConfig.gridWidth || height != shaderConfig.gridHeight)) {
+                snprintf(kept[numKept++], sizeof(kept[0]), "%s", line);
+            }
+        }
+        fclose(file);
+    }
+
+    file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return 0;
+    }
+    fprintf(file, "# Work group sizes from StableFluidsBench --autotune: kernel grid_w grid_h local_x local_y\n");
+    fprintf(file, "renderer %s\n", renderer);
+    for (int i = 0; i < numKept; i++) fprintf(file, "%s\n", kept[i]);
+    for (int k = 0; k < TUNE_COUNT; k++) {
+        fprintf(file, "%s %d %d %d %d\n", tunedKernels[k].name, shaderConfig.gridWidth, shaderConfig.gridHeight,
+                tunedKernels[k].localSize[0], tunedKernels[k].localSize[1]);
+    }
+    fclose(file);
+    return 1;
+}
+
+void submitFillPipeline(FillPipeline* f, int k, const char* filename, GLenum format) {
+    submitTunedPipeline(&f->pipeline, k, filename, NULL);
+    f->format = format;
+}
+
+// Uniform locations, once the build has finished
+void resolveFillPipeline(FillPipeline* f) {
+    f->sizeLoc = glGetUniformLocation(f->pipeline.program, "fillSize");
+    f->valueLoc = glGetUniformLocation(f->pipeline.program, "fillValue");
+    f->spotRectLoc = glGetUniformLocation(f->pipeline.program, "spotRect");
+    f->spotValueLoc = glGetUniformLocation(f->pipeline.program, "spotValue");
+}
+
+// The pressure builds, with ω compiled in as OMEGA
+static void submitPressurePipelines(void) {
+    char defines[64];
+    char interiorDefines[96];
+    char denseDefines[128];
+    snprintf(defines, sizeof(defines), "#define OMEGA float(%.9g)\n", pressureOmega);
+    snprintf(interiorDefines, sizeof(interiorDefines), "%s#define INTERIOR\n", defines);
+    snprintf(denseDefines, sizeof(denseDefines), "%s#define DENSE\n", interiorDefines);
+    submitComputePipeline(&pressurePipeline, "shaders/pressure.comp", defines);
+    submitComputePipeline(&pressureInteriorPipeline, "shaders/pressure.comp", interiorDefines);
+    submitTunedPipeline(&pressureDensePipeline, TUNE_PRESSURE, "shaders/pressure.comp", denseDefines);
+}
+
+static void resolvePressurePipelines(void) {
+    pressureRedPassLoc = glGetUniformLocation(pressurePipeline.program, "redPass");
+    pressureTrackResidualLoc = glGetUniformLocation(pressurePipeline.program, "trackResidual");
+    pressureInteriorRedPassLoc = glGetUniformLocation(pressureInteriorPipeline.program, "redPass");
+    pressureInteriorTrackResidualLoc = glGetUniformLocation(pressureInteriorPipeline.program, "trackResidual");
+    pressureDenseRedPassLoc = glGetUniformLocation(pressureDensePipeline.program, "redPass");
+}
+
+// Recompiles the pressure pipelines; the other programs do not depend on ω
+int setPressureOmega(float omega) {
+    pressureOmega = omega;
+    glDeleteProgram(pressurePipeline.program);
+    glDeleteProgram(pressureInteriorPipeline.program);
+    glDeleteProgram(pressureDensePipeline.program);
+    submitPressurePipelines();
+    if (!finishComputePipelines()) return 0;
+    resolvePressurePipelines();
+    return 1;
+}
+
+// Build every compute program for the current shaderConfig and tuned work
+// groups. All builds are submitted before the first one is waited on.
+int compilePipelines(void) {
+    // Using split shaders for MAC grid
+    submitComputePipeline(&advectUPipeline, "shaders/advect_u.comp", NULL);
+    submitComputePipeline(&advectVPipeline, "shaders/advect_v.comp", NULL);
+    submitComputePipeline(&advectDensityPipeline, "shaders/advect_density.comp", NULL);
+    submitComputePipeline(&advectVelocityPipeline, "shaders/advect_velocity.comp", NULL);
+    for (int s = 0; s < ADVECT_STAGES; s++) {
+        submitComputePipeline(&advectUStagePipelines[s], "shaders/advect_u.comp", advectStageDefines[s]);
+        submitComputePipeline(&advectVStagePipelines[s], "shaders/advect_v.comp", advectStageDefines[s]);
+        submitComputePipeline(&advectDensityStagePipelines[s], "shaders/advect_density.comp", advectStageDefines[s]);
+        submitComputePipeline(&advectVelocityStagePipelines[s], "shaders/advect_velocity.comp", advectStageDefines[s]);
+    }
+    submitComputePipeline(&divergencePipeline, "shaders/divergence.comp", NULL);
+    submitTunedPipeline(&divergenceDensePipeline, TUNE_DIVERGENCE, "shaders/divergence.comp", "#define DENSE\n");
+    submitPressurePipelines();
+    submitComputePipeline(&gradientSubtractUPipeline, "shaders/gradient_subtract_u.comp", NULL);
+    submitComputePipeline(&gradientSubtractVPipeline, "shaders/gradient_subtract_v.comp", NULL);
+    submitComputePipeline(&gradientSubtractUInteriorPipeline, "shaders/gradient_subtract_u.comp",
+                          "#define INTERIOR\n");
+    submitComputePipeline(&gradientSubtractVInteriorPipeline, "shaders/gradient_subtract_v.comp",
+                          "#define INTERIOR\n");
+    submitTunedPipeline(&addForceUPipeline, TUNE_ADD_FORCE_U, "shaders/add_force_u.comp", NULL);
+    submitTunedPipeline(&addForceVPipeline, TUNE_ADD_FORCE_V, "shaders/add_force_v.comp", NULL);
+    submitTunedPipeline(&addForceDensityPipeline, TUNE_ADD_FORCE_DENSITY, "shaders/add_force_density.comp", NULL);
+    submitTunedPipeline(&divergenceStatsPipeline, TUNE_DIVERGENCE_STATS, "shaders/divergence_stats.comp", NULL);
+    submitComputePipeline(&statsSummaryPipeline, "shaders/stats_summary.comp", NULL);
+    submitComputePipeline(&flowMetricsPipeline, "shaders/flow_metrics.comp", NULL);
+    submitComputePipeline(&flowMetricsReducePipeline, "shaders/flow_metrics_reduce.comp", NULL);
+    submitComputePipeline(&tileMaskPipeline, "shaders/tile_mask.comp", NULL);
+    submitComputePipeline(&tileCompactPipeline, "shaders/tile_compact.comp", NULL);
+    submitComputePipeline(&tileClearPipeline, "shaders/tile_clear.comp", NULL);
+    submitComputePipeline(&pressureCompactPipeline, "shaders/pressure_compact.comp", NULL);
+    submitFillPipeline(&fillR32FPipeline, TUNE_FILL_R32F, "shaders/fill_r32f.comp", GL_R32F);
+    submitFillPipeline(&fillRGBA32FPipeline, TUNE_FILL_RGBA32F, "shaders/fill_rgba32f.comp", GL_RGBA32F);
+
+    if (!finishComputePipelines()) return 0;
+
+    resolvePressurePipelines();
+    resolveFillPipeline(&fillR32FPipeline);
+    resolveFillPipeline(&fillRGBA32FPipeline);
+    pressureCompactSweepsLoc = glGetUniformLocation(pressureCompactPipeline.program, "listSweeps");
+    return 1;
+}
+
+int createPipelines(void) {
+    int tuned = loadWorkGroupCache(WORK_GROUP_CACHE_FILE);
+    if (tuned > 0) printf("Work groups: %d tuned sizes from %s\n", tuned, WORK_GROUP_CACHE_FILE);
+
+    int parallel = enableParallelShaderCompile();
+    double start = glfwGetTime();
+    int ok = compilePipelines();
+    printf("Pipelines: %d programs in %.0f ms (%d from %s%s)\n",
+           programsCompiled + programsFromCache, (glfwGetTime() - start) * 1000.0, programsFromCache,
+           PROGRAM_CACHE_FILE, parallel ? ", parallel compile" : "");
+    if (!ok) return 0;
+
+    glGenBuffers(1, &frameParamsBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameParamsBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameParams), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_PARAMS_BINDING, frameParamsBuffer);
+
+    glGenBuffers(1, &splatBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, splatBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(splatQueue), NULL, GL_DYNAMIC_DRAW);
+    return 1;
+}
+
+void deletePipelinePrograms(void) {
+    glDeleteProgram(advectUPipeline.program);
+    glDeleteProgram(advectVPipeline.program);
+    glDeleteProgram(advectDensityPipeline.program);
+    glDeleteProgram(advectVelocityPipeline.program);
+    for (int s = 0; s < ADVECT_STAGES; s++) {
+        glDeleteProgram(advectUStagePipelines[s].program);
+        glDeleteProgram(advectVStagePipelines[s].program);
+        glDeleteProgram(advectDensityStagePipelines[s].program);
+        glDeleteProgram(advectVelocityStagePipelines[s].program);
+    }
+    glDeleteProgram(divergencePipeline.program);
+    glDeleteProgram(divergenceDensePipeline.program);
+    glDeleteProgram(pressurePipeline.program);
+    glDeleteProgram(pressureInteriorPipeline.program);
+    glDeleteProgram(pressureDensePipeline.program);
+    glDeleteProgram(gradientSubtractUPipeline.program);
+    glDeleteProgram(gradientSubtractVPipeline.program);
+    glDeleteProgram(gradientSubtractUInteriorPipeline.program);
+    glDeleteProgram(gradientSubtractVInteriorPipeline.program);
+    glDeleteProgram(addForceUPipeline.program);
+    glDeleteProgram(addForceVPipeline.program);
+    glDeleteProgram(addForceDensityPipeline.program);
+    glDeleteProgram(divergenceStatsPipeline.program);
+    glDeleteProgram(statsSummaryPipeline.program);
+    glDeleteProgram(flowMetricsPipeline.program);
+    glDeleteProgram(flowMetricsReducePipeline.program);
+    glDeleteProgram(tileMaskPipeline.program);
+    glDeleteProgram(tileCompactPipeline.program);
+    glDeleteProgram(tileClearPipeline.program);
+    glDeleteProgram(pressureCompactPipeline.program);
+    glDeleteProgram(fillR32FPipeline.pipeline.program);
+    glDeleteProgram(fillRGBA32FPipeline.pipeline.program);
+}
+
+void destroyPipelines(void) {
+    deletePipelinePrograms();
+    freeProgramCache();
+    glDeleteBuffers(1, &frameParamsBuffer);
+    glDeleteBuffers(1, &splatBuffer);
+}
+
+// Distance at which a Gaussian splat exp(-d^2 / r^2) falls below threshold
+float splatCutoffDistance(float radius, float threshold) {
+    return radius * sqrtf(logf(1.0f / threshold));
+}
+
+void uploadFrameParams(const FrameParams* p) {
+    glBindBuffer(GL_UNIFORM_BUFFER, frameParamsBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameParams), p);
+    hostUploadBytes += sizeof(FrameParams);
+}
+
+void uploadSplats(const Splat* splats, int count) {
+    if (count <= 0) return;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, splatBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(Splat), splats);
+    hostUploadBytes += count * sizeof(Splat);
+}
+
+// ============================================================================
+// Frame graph
+// ============================================================================
+// Passes declare the resources they touch and how. Compiling the graph assigns
+// each pass a level one above the latest earlier pass it conflicts with (same
+// resource, at least one writer), so independent passes share a level and run
+// back to back. A single glMemoryBarrier is issued before each level with only
+// the bits its accesses need: every shader write leaves its resource "owing"
+// all barrier bits, and each glMemoryBarrier pays those bits off for every
+// resource at once. Write-after-read only needs ordering, not a barrier.
+
+#define FG_MAX_RESOURCES 48
+#define FG_MAX_PASSES    48
+#define FG_MAX_ACCESSES  8
+#define FG_MAX_EXPORTS   16
+
+typedef enum {
+    FG_IMAGE_READ,          // imageLoad
+    FG_IMAGE_WRITE,         // imageStore
+    FG_IMAGE_READ_WRITE,    // imageLoad + imageStore
+    FG_SAMPLED,             // texture() through a sampler
+    FG_STORAGE_READ,        // readonly SSBO
+    FG_STORAGE_READ_WRITE,  // SSBO access (atomics)
+    FG_INDIRECT,            // glDispatchComputeIndirect arguments
+    FG_TEXTURE_UPDATE,      // Host-side texture write (glTexSubImage2D)
+    FG_BUFFER_UPDATE        // Host-side buffer access (glBufferSubData, readback)
+} FGAccessType;
+
+typedef struct {
+    GLuint object;          // Texture or buffer name
+    int isBuffer;
+    const char* name;       // Label for the schedule printout
+    FGAccessType type;
+    GLuint unit;            // Image unit, texture unit or SSBO binding
+    GLenum format;          // Image format (image accesses only)
+    int resource;           // Resolved at compile time
+} FGAccess;
+
+typedef struct FGPass {
+    const char* name;
+    const ComputePipeline* pipeline;  // NULL for host passes
+    int x, y;                         // Dispatch origin (kernels with dispatchOrigin)
+    int width, height;                // Dispatch domain
+    GLuint indirectBuffer;            // Indirect dispatch arguments, if set
+    GLintptr indirectOffset;
+    int ring;                         // Outer tile ring of width x height only (boundary kernels)
+    int splitGroup;                   // Interior + ring passes of one split kernel write disjoint cells
+    void (*execute)(const struct FGPass* pass);  // Overrides the single bind+dispatch
+    FGAccess access[FG_MAX_ACCESSES];
+    int numAccess;
+    int level;
+} FGPass;
+
+typedef struct {
+    GLuint object;
+    int isBuffer;
+    const char* name;
+    GLbitfield pending;     // Barrier bits still owed since the last shader write
+} FGResource;
+
+typedef struct {
+    FGResource resources[FG_MAX_RESOURCES];  // Persist across frames
+    int numResources;
+    FGPass passes[FG_MAX_PASSES];
+    int numPasses;
+    FGAccess exports[FG_MAX_EXPORTS];        // Consumers after the graph (render, readback)
+    int numExports;
+    int numLevels;
+    GLbitfield levelBarrier[FG_MAX_PASSES + 1];  // Issued before level i; last entry for exports
+} FrameGraph;
+
+FrameGraph frameGraph;
+int printFrameGraphPending = 1;  // Print the schedule after the next execution
+
+#define FG_TEXTURE_BITS (GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | \
+                         GL_TEXTURE_UPDATE_BARRIER_BIT)
+#define FG_BUFFER_BITS  (GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT | \
+                         GL_COMMAND_BARRIER_BIT)
+
+static int fgIsWrite(FGAccessType type) {
+    return type == FG_IMAGE_WRITE || type == FG_IMAGE_READ_WRITE ||
+           type == FG_STORAGE_READ_WRITE || type == FG_TEXTURE_UPDATE || type == FG_BUFFER_UPDATE;
+}
+
+static int fgIsShaderWrite(FGAccessType type) {
+    return type == FG_IMAGE_WRITE || type == FG_IMAGE_READ_WRITE || type == FG_STORAGE_READ_WRITE;
+}
+
+// Barrier bit that makes earlier shader writes visible to this kind of access
+static GLbitfield fgBarrierBit(FGAccessType type) {
+    switch (type) {
+        case FG_IMAGE_READ:
+        case FG_IMAGE_WRITE:
+        case FG_IMAGE_READ_WRITE:   return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+        case FG_SAMPLED:            return GL_TEXTURE_FETCH_BARRIER_BIT;
+        case FG_STORAGE_READ:
+        case FG_STORAGE_READ_WRITE: return GL_SHADER_STORAGE_BARRIER_BIT;
+        case FG_INDIRECT:           return GL_COMMAND_BARRIER_BIT;
+        case FG_TEXTURE_UPDATE:     return GL_TEXTURE_UPDATE_BARRIER_BIT;
+        case FG_BUFFER_UPDATE:      return GL_BUFFER_UPDATE_BARRIER_BIT;
+    }
+    return 0;
+}
+
+void fgBegin(FrameGraph* g) {
+    g->numPasses = 0;
+    g->numExports = 0;
+    g->numLevels = 0;
+}
+
+FGPass* fgAddPass(FrameGraph* g, const char* name, const ComputePipeline* pipeline, int width, int height) {
+    if (g->numPasses >= FG_MAX_PASSES) {
+        fprintf(stderr, "Frame graph: too many passes (%s)\n", name);
+        exit(1);
+    }
+    FGPass* p = &g->passes[g->numPasses++];
+    memset(p, 0, sizeof(*p));
+    p->name = name;
+    p->pipeline = pipeline;
+    p->width = width;
+    p->height = height;
+    return p;
+}
+
+// Pass over the rectangle [x, x + width) x [y, y + height) of its field. The
+// kernel adds its dispatchOrigin uniform to the invocation ID.
+FGPass* fgAddRegionPass(FrameGraph* g, const char* name, const ComputePipeline* pipeline, const int rect[4]) {
+    FGPass* p = fgAddPass(g, name, pipeline, rect[2] - rect[0], rect[3] - rect[1]);
+    p->x = rect[0];
+    p->y = rect[1];
+    return p;
+}
+
+// Boundary kernel over the outer ring of tiles of a width x height field
+FGPass* fgAddRingPass(FrameGraph* g, const char* name, const ComputePipeline* pipeline, int width, int height) {
+    FGPass* p = fgAddPass(g, name, pipeline, width, height);
+    p->ring = 1;
+    return p;
+}
+
+// Pass with its own execute callback: host GL work (uploads, buffer clears) or
+// dispatches that need per-dispatch uniforms (fills, the pressure loop)
+FGPass* fgAddHostPass(FrameGraph* g, const char* name, void (*execute)(const FGPass* pass)) {
+    FGPass* p = fgAddPass(g, name, NULL, 0, 0);
+    p->execute = execute;
+    return p;
+}
+
+static void fgAddAccess(FGPass* p, const char* name, GLuint object, int isBuffer,
+                        FGAccessType type, GLuint unit, GLenum format) {
+    if (p->numAccess >= FG_MAX_ACCESSES) {
+        fprintf(stderr, "Frame graph: too many accesses in pass %s\n", p->name);
+        exit(1);
+    }
+    FGAccess* a = &p->access[p->numAccess++];
+    a->object = object;
+    a->isBuffer = isBuffer;
+    a->name = name;
+    a->type = type;
+    a->unit = unit;
+    a->format = format;
+    a->resource = -1;
+}
+
+void fgImage(FGPass* p, GLuint unit, const char* name, GLuint tex, FGAccessType type, GLenum format) {
+    fgAddAccess(p, name, tex, 0, type, unit, format);
+}
+
+void fgSampler(FGPass* p, GLuint unit, const char* name, GLuint tex) {
+    fgAddAccess(p, name, tex, 0, FG_SAMPLED, unit, 0);
+}
+
+void fgStorage(FGPass* p, GLuint binding, const char* name, GLuint buffer) {
+    fgAddAccess(p, name, buffer, 1, FG_STORAGE_READ_WRITE, binding, 0);
+}
+
+void fgStorageRead(FGPass* p, GLuint binding, const char* name, GLuint buffer) {
+    fgAddAccess(p, name, buffer, 1, FG_STORAGE_READ, binding, 0);
+}
+
+void fgTextureUpdate(FGPass* p, const char* name, GLuint tex) {
+    fgAddAccess(p, name, tex, 0, FG_TEXTURE_UPDATE, 0, 0);
+}
+
+void fgBufferUpdate(FGPass* p, const char* name, GLuint buffer) {
+    fgAddAccess(p, name, buffer, 1, FG_BUFFER_UPDATE, 0, 0);
+}
+
+// Pass dispatched with glDispatchComputeIndirect, its work group count read from
+// buffer at offset (written by an earlier pass)
+FGPass* fgAddIndirectPass(FrameGraph* g, const char* name, const ComputePipeline* pipeline,
+                          const char* bufferName, GLuint buffer, GLintptr offset) {
+    FGPass* p = fgAddPass(g, name, pipeline, 0, 0);
+    p->indirectBuffer = buffer;
+    p->indirectOffset = offset;
+    fgAddAccess(p, bufferName, buffer, 1, FG_INDIRECT, 0, 0);
+    return p;
+}
+
+// Declare a consumer outside the graph (render samples, buffer readback)
+void fgExport(FrameGraph* g, const char* name, GLuint object, int isBuffer, FGAccessType type) {
+    if (!object || g->numExports >= FG_MAX_EXPORTS) return;
+    FGAccess* a = &g->exports[g->numExports++];
+    memset(a, 0, sizeof(*a));
+    a->object = object;
+    a->isBuffer = isBuffer;
+    a->name = name;
+    a->type = type;
+    a->resource = -1;
+}
+
+static int fgResolve(FrameGraph* g, FGAccess* a) {
+    for (int i = 0; i < g->numResources; i++) {
+        FGResource* r = &g->resources[i];
+        if (r->object == a->object && r->isBuffer == a->isBuffer) {
+            r->name = a->name;
+            return i;
+        }
+    }
+    if (g->numResources >= FG_MAX_RESOURCES) {
+        fprintf(stderr, "Frame graph: too many resources (%s)\n", a->name);
+        exit(1);
+    }
+    // New objects start clean; a recycled GL name just keeps its (conservative) state
+    FGResource* r = &g->resources[g->numResources];
+    r->object = a->object;
+    r->isBuffer = a->isBuffer;
+    r->name = a->name;
+    r->pending = 0;
+    return g->numResources++;
+}
+
+void fgCompile(FrameGraph* g) {
+    for (int i = 0; i < g->numPasses; i++) {
+        FGPass* p = &g->passes[i];
+        for (int k = 0; k < p->numAccess; k++) {
+            p->access[k].resource = fgResolve(g, &p->access[k]);
+        }
+        p->level = 0;
+        for (int j = 0; j < i; j++) {
+            FGPass* q = &g->passes[j];
+            int conflict = 0;
+            if (p->splitGroup && p->splitGroup == q->splitGroup) continue;
+            for (int k = 0; k < p->numAccess && !conflict; k++) {
+                for (int m = 0; m < q->numAccess; m++) {
+                    if (p->access[k].resource == q->access[m].resource &&
+                        (fgIsWrite(p->access[k].type) || fgIsWrite(q->access[m].type))) {
+                        conflict = 1;
+                        break;
+                    }
+                }
+            }
+            if (conflict && q->level + 1 > p->level) p->level = q->level + 1;
+        }
+        if (p->level + 1 > g->numLevels) g->numLevels = p->level + 1;
+    }
+    for (int i = 0; i < g->numExports; i++) {
+        g->exports[i].resource = fgResolve(g, &g->exports[i]);
+    }
+}
+
+// Barrier bits the given accesses still need
+static GLbitfield fgOwed(const FrameGraph* g, const FGAccess* access, int count) {
+    GLbitfield bits = 0;
+    for (int k = 0; k < count; k++) {
+        bits |= g->resources[access[k].resource].pending & fgBarrierBit(access[k].type);
+    }
+    return bits;
+}
+
+// glMemoryBarrier is global: issuing bits pays them off for every resource
+static void fgIssue(FrameGraph* g, GLbitfield bits) {
+    if (!bits) return;
+    glMemoryBarrier(bits);
+    for (int i = 0; i < g->numResources; i++) {
+        g->resources[i].pending &= ~bits;
+    }
+}
+
+// Bind a pass's declared resources and its program
+void fgBindPass(const FGPass* p) {
+    if (p->pipeline) glUseProgram(p->pipeline->program);
+    if (p->pipeline && p->pipeline->originLoc >= 0) glUniform2i(p->pipeline->originLoc, p->x, p->y);
+    if (p->pipeline && p->pipeline->tileDispatchLoc >= 0) {
+        glUniform1i(p->pipeline->tileDispatchLoc, p->indirectBuffer != 0);
+    }
+    if (p->pipeline && p->pipeline->ringDispatchLoc >= 0) glUniform1i(p->pipeline->ringDispatchLoc, p->ring);
+    for (int k = 0; k < p->numAccess; k++) {
+        const FGAccess* a = &p->access[k];
+        switch (a->type) {
+            case FG_IMAGE_READ:
+                glBindImageTexture(a->unit, a->object, 0, GL_FALSE, 0, GL_READ_ONLY, a->format);
+                break;
+            case FG_IMAGE_WRITE:
+                glBindImageTexture(a->unit, a->object, 0, GL_FALSE, 0, GL_WRITE_ONLY, a->format);
+                break;
+            case FG_IMAGE_READ_WRITE:
+                glBindImageTexture(a->unit, a->object, 0, GL_FALSE, 0, GL_READ_WRITE, a->format);
+                break;
+            case FG_SAMPLED:
+                glActiveTexture(GL_TEXTURE0 + a->unit);
+                glBindTexture(GL_TEXTURE_2D, a->object);
+                break;
+            case FG_STORAGE_READ:
+            case FG_STORAGE_READ_WRITE:
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, a->unit, a->object);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void fgExecute(FrameGraph* g) {
+    for (int level = 0; level < g->numLevels; level++) {
+        GLbitfield bits = 0;
+        for (int i = 0; i < g->numPasses; i++) {
+            if (g->passes[i].level == level) {
+                bits |= fgOwed(g, g->passes[i].access, g->passes[i].numAccess);
+            }
+        }
+        fgIssue(g, bits);
+        g->levelBarrier[level] = bits;
+
+        for (int i = 0; i < g->numPasses; i++) {
+            FGPass* p = &g->passes[i];
+            if (p->level != level) continue;
+            glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, p->name);
+            if (p->execute) {
+                p->execute(p);
+            } else {
+                fgBindPass(p);
+                if (p->indirectBuffer) {
+                    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, p->indirectBuffer);
+                    glDispatchComputeIndirect(p->indirectOffset);
+                } else if (p->ring) {
+                    glDispatchCompute(ringTileCount(p->width, p->height), 1, 1);
+                } else {
+                    dispatchPipeline(p->pipeline, p->width, p->height);
+                }
+            }
+            glPopDebugGroup();
+
+            for (int k = 0; k < p->numAccess; k++) {
+                FGResource* r = &g->resources[p->access[k].resource];
+                if (fgIsShaderWrite(p->access[k].type)) {
+                    r->pending = r->isBuffer ? FG_BUFFER_BITS : FG_TEXTURE_BITS;
+                } else if (fgIsWrite(p->access[k].type)) {
+                    r->pending = 0;  // Host writes are synchronized by GL
+                }
+            }
+        }
+    }
+    GLbitfield exportBits = fgOwed(g, g->exports, g->numExports);
+    fgIssue(g, exportBits);
+    g->levelBarrier[g->numLevels] = exportBits;
+}
+
+static void fgPrintBits(GLbitfield bits) {
+    if (bits & GL_SHADER_IMAGE_ACCESS_BARRIER_BIT) printf(" IMAGE");
+    if (bits & GL_TEXTURE_FETCH_BARRIER_BIT) printf(" FETCH");
+    if (bits & GL_TEXTURE_UPDATE_BARRIER_BIT) printf(" TEXTURE_UPDATE");
+    if (bits & GL_SHADER_STORAGE_BARRIER_BIT) printf(" STORAGE");
+    if (bits & GL_BUFFER_UPDATE_BARRIER_BIT) printf(" BUFFER_UPDATE");
+    if (bits & GL_COMMAND_BARRIER_BIT) printf(" COMMAND");
+    printf("\n");
+}
+
+// Record a shader write made outside the graph (reset, test setup) so the next
+// pass that reads the texture waits for it
+void fgNoteShaderWrite(FrameGraph* g, GLuint tex) {
+    FGAccess a = {0};
+    a.object = tex;
+    a.name = "";
+    g->resources[fgResolve(g, &a)].pending = FG_TEXTURE_BITS;
+}
+
+void fgPrint(const FrameGraph* g) {
+    static const char* accessNames[] = {"img-r", "img-w", "img-rw", "tex", "ssbo-r", "ssbo", "indirect", "upload", "buffer"};
+    int barriers = 0;
+    for (int level = 0; level <= g->numLevels; level++) {
+        if (g->levelBarrier[level]) barriers++;
+    }
+    printf("\nFrame graph: %d passes, %d levels, %d barriers\n", g->numPasses, g->numLevels, barriers);
+    for (int level = 0; level < g->numLevels; level++) {
+        if (g->levelBarrier[level]) {
+            printf("  -- barrier:");
+            fgPrintBits(g->levelBarrier[level]);
+        }
+        for (int i = 0; i < g->numPasses; i++) {
+            const FGPass* p = &g->passes[i];
+            if (p->level != level) continue;
+            printf("  [%d] %-22s", level, p->name);
+            if (p->indirectBuffer) {
+                printf(" tiles");
+            } else if (p->ring) {
+                printf(" ring of %dx%d", p->width, p->height);
+            } else if (p->pipeline && p->pipeline->originLoc >= 0 && !p->execute) {
+                printf(" %dx%d at (%d,%d)", p->width, p->height, p->x, p->y);
+            }
+            for (int k = 0; k < p->numAccess; k++) {
+                printf(" %s(%s)", p->access[k].name, accessNames[p->access[k].type]);
+            }
+            printf("\n");
+        }
+    }
+    if (g->levelBarrier[g->numLevels]) {
+        printf("  -- barrier (render/readback):");
+        fgPrintBits(g->levelBarrier[g->numLevels]);
+    }
+}
+
+// Zero a width x height texture on the GPU, writing spotValue into the cells of
+// spotRect (x0, y0, x1, y1; exclusive max). Pass NULL for a plain clear.
+void fillTexture(const FillPipeline* f, GLuint tex, int width, int height,
+                 const int spotRect[4], float spotValue) {
+    static const int noSpot[4] = {0, 0, 0, 0};
+    const int* spot = spotRect ? spotRect : noSpot;
+    glUseProgram(f->pipeline.program);
+    glUniform2i(f->sizeLoc, width, height);
+    glUniform4f(f->valueLoc, 0.0f, 0.0f, 0.0f, 0.0f);
+    glUniform4i(f->spotRectLoc, spot[0], spot[1], spot[2], spot[3]);
+    glUniform4f(f->spotValueLoc, spotValue, spotValue, spotValue, spotValue);
+    glBindImageTexture(0, tex, 0, GL_FALSE, 0, GL_WRITE_ONLY, f->format);
+    dispatchPipeline(&f->pipeline, width, height);
+    fgNoteShaderWrite(&frameGraph, tex);
+}
+
+void clearTextureR(GLuint tex) {
+    fillTexture(&fillR32FPipeline, tex, SIM_WIDTH, SIM_HEIGHT, NULL, 0.0f);
 }
 
 void clearTextureRGBA(GLuint tex) {
-    glBindTexture(GL_TEXTURE_2D, tex);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SIM_WIDTH, SIM_HEIGHT, GL_RGBA, GL_FLOAT, clearDataRGBA);
+    fillTexture(&fillRGBA32FPipeline, tex, SIM_WIDTH, SIM_HEIGHT, NULL, 0.0f);
 }
 
 void clearTextureU(GLuint tex) {
-    glBindTexture(GL_TEXTURE_2D, tex);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, U_WIDTH, U_HEIGHT, GL_RED, GL_FLOAT, clearDataU);
+    fillTexture(&fillR32FPipeline, tex, U_WIDTH, U_HEIGHT, NULL, 0.0f);
 }
 
 void clearTextureV(GLuint tex) {
-    glBindTexture(GL_TEXTURE_2D, tex);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, V_WIDTH, V_HEIGHT, GL_RED, GL_FLOAT, clearDataV);
+    fillTexture(&fillR32FPipeline, tex, V_WIDTH, V_HEIGHT, NULL, 0.0f);
 }
 
 void createTextures(void) {
@@ -249,7 +1865,7 @@ void createTextures(void) {
     glGenTextures(2, uVelocityTex);
     for (int i = 0; i < 2; i++) {
         glBindTexture(GL_TEXTURE_2D, uVelocityTex[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, U_WIDTH, U_HEIGHT, 0, GL_RED, GL_FLOAT, NULL);
+        glTexImage2D(GL_TEXTURE_2D, 0, VELOCITY_FORMAT, U_WIDTH, U_HEIGHT, 0, GL_RED, GL_FLOAT, NULL);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
@@ -261,48 +1877,21 @@ void createTextures(void) {
     glGenTextures(2, vVelocityTex);
     for (int i = 0; i < 2; i++) {
         glBindTexture(GL_TEXTURE_2D, vVelocityTex[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, V_WIDTH, V_HEIGHT, 0, GL_RED, GL_FLOAT, NULL);
+        glTexImage2D(GL_TEXTURE_2D, 0, VELOCITY_FORMAT, V_WIDTH, V_HEIGHT, 0, GL_RED, GL_FLOAT, NULL);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-    }
-
-    // Pressure textures (R32F)
-    glGenTextures(2, pressureTex);
-    for (int i = 0; i < 2; i++) {
-        glBindTexture(GL_TEXTURE_2D, pressureTex[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, SIM_WIDTH, SIM_HEIGHT, 0, GL_RED, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
     }
 
-    // Divergence texture (R32F) - stores pre-projection divergence
-    glGenTextures(1, &divergenceTex);
-    glBindTexture(GL_TEXTURE_2D, divergenceTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, SIM_WIDTH, SIM_HEIGHT, 0, GL_RED, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    // Post-divergence texture (R32F) - stores post-projection divergence
-    glGenTextures(1, &postDivergenceTex);
-    glBindTexture(GL_TEXTURE_2D, postDivergenceTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, SIM_WIDTH, SIM_HEIGHT, 0, GL_RED, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // Pressure and divergence fields are transient (see acquireTransient)
 
     // Density textures (RGBA32F for colored dye) - use CLAMP_TO_BORDER for open boundaries
     glGenTextures(2, densityTex);
     for (int i = 0; i < 2; i++) {
         glBindTexture(GL_TEXTURE_2D, densityTex[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, SIM_WIDTH, SIM_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexImage2D(GL_TEXTURE_2D, 0, DENSITY_FORMAT, SIM_WIDTH, SIM_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
@@ -311,75 +1900,312 @@ void createTextures(void) {
     }
 }
 
-void clearStats2D(void) {
-    DivergenceStats2D zero = {{0}};
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(DivergenceStats2D), &zero);
+// Tile lists and flags; the flags start out as "retiring" (see resetTilesPass).
+// Also the pressure active set, whose residuals start (and are left) at zero.
+void createTileBuffers(void) {
+    glGenBuffers(1, &tileListBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileListBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, TILE_LIST_BYTES, NULL, GL_DYNAMIC_COPY);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+    glGenBuffers(1, &tileFlagsBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileFlagsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, TILE_FLAGS_BYTES, NULL, GL_DYNAMIC_COPY);
+    tileStateValid = 0;
+
+    glGenBuffers(1, &solveListBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, solveListBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, SOLVE_LIST_BYTES, NULL, GL_DYNAMIC_COPY);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+    glGenBuffers(1, &solveResidualBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, solveResidualBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, SOLVE_RESIDUAL_BYTES, NULL, GL_DYNAMIC_COPY);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+    glGenBuffers(1, &counterReadback.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, counterReadback.buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, METRICS_READBACK_FRAMES * COUNTER_SLOT_BYTES, NULL, GL_STREAM_READ);
 }
 
-void computeStats2D(GLuint preTex, GLuint postTex) {
-    glUseProgram(divergenceStatsProgram);
-    glBindImageTexture(0, preTex, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-    glBindImageTexture(1, postTex, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, statsBuffer);
-    glDispatchCompute((SIM_WIDTH+15)/16, (SIM_HEIGHT+15)/16, 1);
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+void destroyTileBuffers(void) {
+    for (int i = 0; i < METRICS_READBACK_FRAMES; i++) {
+        if (counterReadback.fences[i]) glDeleteSync(counterReadback.fences[i]);
+        counterReadback.fences[i] = 0;
+    }
+    glDeleteBuffers(1, &counterReadback.buffer);
+    glDeleteBuffers(1, &tileListBuffer);
+    glDeleteBuffers(1, &tileFlagsBuffer);
+    glDeleteBuffers(1, &solveListBuffer);
+    glDeleteBuffers(1, &solveResidualBuffer);
 }
 
-// Get top 3 bins for pre and post divergence
-void getTopBins(int* preBins, int* preCounts, int* postBins, int* postCounts) {
-    DivergenceStats2D stats;
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
-    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(DivergenceStats2D), &stats);
+void createFlowMetricsBuffers(void) {
+    glGenBuffers(1, &flowPartialsBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, flowPartialsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, FLOW_PARTIALS_BYTES, NULL, GL_DYNAMIC_COPY);
 
-    // Sum pre-divergence bins (columns) - 40 pre-bins
-    unsigned int preSums[36] = {0};
-    unsigned int postSums[32] = {0};
+    glGenBuffers(1, &flowMetricsBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, flowMetricsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(FlowMetrics), NULL, GL_DYNAMIC_COPY);
 
-    for (int post = 0; post < 32; post++) {
-        for (int pre = 0; pre < 36; pre++) {
-            unsigned int count = stats.histogram[post * 36 + pre];
-            preSums[pre] += count;
-            postSums[post] += count;
+    glGenBuffers(1, &metricsReadback.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, metricsReadback.buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, METRICS_READBACK_FRAMES * sizeof(FlowMetrics), NULL, GL_STREAM_READ);
+}
+
+void destroyFlowMetricsBuffers(void) {
+    for (int i = 0; i < METRICS_READBACK_FRAMES; i++) {
+        if (metricsReadback.fences[i]) glDeleteSync(metricsReadback.fences[i]);
+        metricsReadback.fences[i] = 0;
+    }
+    glDeleteBuffers(1, &metricsReadback.buffer);
+    glDeleteBuffers(1, &flowMetricsBuffer);
+    glDeleteBuffers(1, &flowPartialsBuffer);
+}
+
+// Hand out a pooled texture matching format and size, creating one if none is free.
+// The filter only matters when the texture is displayed by render().
+GLuint acquireTransient(const char* user, GLenum format, int width, int height, GLint filter) {
+    TransientTexture* slot = NULL;
+    for (int i = 0; i < TRANSIENT_POOL_SIZE; i++) {
+        TransientTexture* t = &transientPool[i];
+        if (t->tex && !t->inUse && t->format == format && t->width == width && t->height == height) {
+            slot = t;
+            break;
+        }
+    }
+    if (!slot) {
+        for (int i = 0; i < TRANSIENT_POOL_SIZE && !slot; i++) {
+            if (!transientPool[i].tex) slot = &transientPool[i];
         }
+        if (!slot) {
+            fprintf(stderr, "Transient pool exhausted (%s)\n", user);
+            exit(1);
+        }
+        memset(slot, 0, sizeof(*slot));
+        slot->format = format;
+        slot->width = width;
+        slot->height = height;
+        glGenTextures(1, &slot->tex);
+        glBindTexture(GL_TEXTURE_2D, slot->tex);
+        glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    if (slot->filter != filter) {
+        glBindTexture(GL_TEXTURE_2D, slot->tex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        slot->filter = filter;
     }
+    slot->inUse = 1;
+    if (slot->uses < TRANSIENT_MAX_USERS) slot->users[slot->uses] = user;
+    slot->uses++;
+    return slot->tex;
+}
 
-    // Find top 3 for pre (highest bin index with counts, i.e., worst divergence)
-    for (int i = 0; i < 3; i++) {
-        preBins[i] = -1;
-        preCounts[i] = 0;
-        postBins[i] = -1;
-        postCounts[i] = 0;
+// Return a texture to the pool; later requests this frame may reuse its memory
+void releaseTransient(GLuint tex) {
+    for (int i = 0; i < TRANSIENT_POOL_SIZE; i++) {
+        if (transientPool[i].tex == tex) transientPool[i].inUse = 0;
     }
+}
 
-    // Pre-bins go up to 39 now
-    for (int b = 35; b >= 0; b--) {
-        if (preSums[b] > 0) {
-            for (int i = 0; i < 3; i++) {
-                if (preBins[i] == -1) {
-                    preBins[i] = b - 24;
-                    preCounts[i] = preSums[b];
-                    break;
-                }
-            }
+// Start of frame: everything is free again, and entries nobody used last frame are deleted
+void beginTransientFrame(void) {
+    for (int i = 0; i < TRANSIENT_POOL_SIZE; i++) {
+        TransientTexture* t = &transientPool[i];
+        if (t->tex && t->uses == 0) {
+            glDeleteTextures(1, &t->tex);
+            t->tex = 0;
         }
+        t->inUse = 0;
+        t->uses = 0;
     }
+}
 
-    // Post-bins still go to 31
-    for (int b = 31; b >= 0; b--) {
-        if (postSums[b] > 0) {
-            for (int i = 0; i < 3; i++) {
-                if (postBins[i] == -1) {
-                    postBins[i] = b - 24;
-                    postCounts[i] = postSums[b];
-                    break;
-                }
-            }
+void destroyTransients(void) {
+    for (int i = 0; i < TRANSIENT_POOL_SIZE; i++) {
+        if (transientPool[i].tex) glDeleteTextures(1, &transientPool[i].tex);
+        transientPool[i].tex = 0;
+    }
+}
+
+static int bytesPerTexel(GLenum format) {
+    switch (format) {
+        case GL_RGBA32F: return 16;
+        case GL_R32F:    return 4;
+        case GL_R8:      return 1;
+    }
+    return 0;
+}
+
+static void printMemoryLine(const char* name, const char* kind, double bytes, const char* note) {
+    if (bytes < 1024.0 * 1024.0) {
+        printf("  %-18s %-22s %9.2f KB  %s\n", name, kind, bytes / 1024.0, note);
+    } else {
+        printf("  %-18s %-22s %9.2f MB  %s\n", name, kind, bytes / (1024.0 * 1024.0), note);
+    }
+}
+
+// GPU and CPU memory held by the simulation, per field
+void printMemoryReport(void) {
+    char kind[64], note[128];
+    double gpu = 0.0, bytes;
+
+    printf("\nMemory report (%dx%d grid)\n", SIM_WIDTH, SIM_HEIGHT);
+    printf("GPU:\n");
+    bytes = 2.0 * U_WIDTH * U_HEIGHT * bytesPerTexel(VELOCITY_FORMAT);
+    printMemoryLine("u velocity", "R32F 513x512 x2", bytes, "ping-pong");
+    gpu += bytes;
+    bytes = 2.0 * V_WIDTH * V_HEIGHT * bytesPerTexel(VELOCITY_FORMAT);
+    printMemoryLine("v velocity", "R32F 512x513 x2", bytes, "ping-pong");
+    gpu += bytes;
+    bytes = 2.0 * SIM_WIDTH * SIM_HEIGHT * bytesPerTexel(DENSITY_FORMAT);
+    printMemoryLine("density", "RGBA32F 512x512 x2", bytes, "ping-pong");
+    gpu += bytes;
+
+    for (int i = 0; i < TRANSIENT_POOL_SIZE; i++) {
+        const TransientTexture* t = &transientPool[i];
+        if (!t->tex) continue;
+        snprintf(kind, sizeof(kind), "%s %dx%d", t->format == GL_RGBA32F ? "RGBA32F" : "R32F",
+                 t->width, t->height);
+        note[0] = '\0';
+        for (int u = 0; u < t->uses && u < TRANSIENT_MAX_USERS; u++) {
+            if (u) strncat(note, " + ", sizeof(note) - strlen(note) - 1);
+            strncat(note, t->users[u], sizeof(note) - strlen(note) - 1);
         }
+        bytes = (double)t->width * t->height * bytesPerTexel(t->format);
+        printMemoryLine(i == 0 ? "transient pool" : "", kind, bytes, note);
+        gpu += bytes;
+    }
+
+    if (statsBuffer) {
+        bytes = sizeof(DivergenceStats2D);
+        printMemoryLine("stats histogram", "SSBO", bytes, "diagnostics only");
+        gpu += bytes;
+        bytes = sizeof(StatsSummary);
+        printMemoryLine("stats summary", "SSBO", bytes, "diagnostics only");
+        gpu += bytes;
+    }
+    if (statsHistoryBuffer) {
+        snprintf(kind, sizeof(kind), "SSBO %d entries", HISTORY_FRAMES);
+        bytes = STATS_HISTORY_BYTES;
+        printMemoryLine("stats history", kind, bytes, "kept while diagnostics are off");
+        gpu += bytes;
+    }
+    bytes = sizeof(FrameParams);
+    printMemoryLine("frame params", "UBO", bytes, "");
+    gpu += bytes;
+    bytes = sizeof(splatQueue);
+    printMemoryLine("splat queue", "SSBO", bytes, "");
+    gpu += bytes;
+    snprintf(kind, sizeof(kind), "SSBO %dx%d tiles", TILES_X, TILES_Y);
+    bytes = TILE_LIST_BYTES;
+    printMemoryLine("tile lists", kind, bytes, "active + retiring");
+    gpu += bytes;
+    bytes = TILE_FLAGS_BYTES;
+    printMemoryLine("tile flags", kind, bytes, "mask + retire countdown");
+    gpu += bytes;
+    snprintf(kind, sizeof(kind), "SSBO %dx%d tiles", SOLVE_TILES_X, SOLVE_TILES_Y);
+    bytes = SOLVE_LIST_BYTES;
+    printMemoryLine("solve list", kind, bytes, "pressure active set");
+    gpu += bytes;
+    bytes = SOLVE_RESIDUAL_BYTES;
+    printMemoryLine("solve residuals", kind, bytes, "");
+    gpu += bytes;
+    bytes = METRICS_READBACK_FRAMES * COUNTER_SLOT_BYTES;
+    printMemoryLine("HUD counters", "readback", bytes, "active + swept tiles");
+    gpu += bytes;
+    snprintf(kind, sizeof(kind), "SSBO %dx%d tiles", SOLVE_TILES_X, SOLVE_TILES_Y);
+    bytes = FLOW_PARTIALS_BYTES;
+    printMemoryLine("flow partials", kind, bytes, "");
+    gpu += bytes;
+    bytes = sizeof(FlowMetrics) * (1 + METRICS_READBACK_FRAMES);
+    printMemoryLine("flow metrics", "SSBO + readback", bytes, "");
+    gpu += bytes;
+    bytes = 128.0 * 64.0 * bytesPerTexel(GL_R8);
+    printMemoryLine("font", "R8 128x64", bytes, "");
+    gpu += bytes;
+    bytes = sizeof(HudGlyph) * HUD_MAX_GLYPHS * HUD_FRAMES;
+    printMemoryLine("hud glyphs", "VBO", bytes, hud.mapped ? "persistently mapped" : "");
+    gpu += bytes;
+    printf("  Total GPU: %.2f MB\n", gpu / (1024.0 * 1024.0));
+
+    printf("CPU:\n");
+    printf("  no simulation state (clears and test impulses are GPU fills)\n");
+    snprintf(kind, sizeof(kind), "%d entries", HISTORY_FRAMES);
+    printMemoryLine("history metadata", kind, sizeof(statsHistoryEntries), "frame, dt and solver settings");
+}
+
+// Stats buffer only exists while diagnostics need it
+void createDiagnosticsResources(void) {
+    // The history survives the diagnostics level, so a dump still covers earlier runs
+    if (!statsHistoryBuffer) {
+        glGenBuffers(1, &statsHistoryBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsHistoryBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, STATS_HISTORY_BYTES, NULL, GL_DYNAMIC_READ);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+        statsHistoryWritten = 0;
+    }
+    if (statsBuffer) return;
+
+    // Stats buffer (2D histogram), zeroed so readers see no data until the first pass
+    glGenBuffers(1, &statsBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(DivergenceStats2D), NULL, GL_DYNAMIC_READ);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+    // Summary, all zero (no bins) until the first stats pass. Only shaders read it.
+    StatsSummary empty = {{0}};
+    for (int i = 0; i < 3; i++) empty.topPreBins[i] = empty.topPostBins[i] = -1;
+    glGenBuffers(1, &statsSummaryBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsSummaryBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(StatsSummary), &empty, GL_DYNAMIC_COPY);
+}
+
+void releaseDiagnosticsResources(void) {
+    if (!statsBuffer) return;
+    glDeleteBuffers(1, &statsBuffer);
+    glDeleteBuffers(1, &statsSummaryBuffer);
+    statsBuffer = 0;
+    statsSummaryBuffer = 0;
+}
+
+// Histogram runs on diagnostics frames only; debug test mode always collects it
+int diagnosticsDue(void) {
+    if (debugTestMode || diagnosticsLevel == DIAGNOSTICS_FULL) return 1;
+    if (diagnosticsLevel == DIAGNOSTICS_SAMPLED) return simFrame % diagnosticsInterval == 0;
+    return 0;
+}
+
+// Allocate or free diagnostics resources after a level/view change
+void updateDiagnosticsResources(void) {
+    if (diagnosticsLevel == DIAGNOSTICS_OFF && !debugTestMode && displayMode != 3) {
+        releaseDiagnosticsResources();
+    } else {
+        createDiagnosticsResources();
     }
 }
 
+void clearStats2D(void) {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+}
+
+void computeStats2D(GLuint preTex, GLuint postTex) {
+    glUseProgram(divergenceStatsPipeline.program);
+    glBindImageTexture(0, preTex, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, postTex, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, statsBuffer);
+    dispatchPipeline(&divergenceStatsPipeline, SIM_WIDTH, SIM_HEIGHT);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
 void debugPrintMarginals(void) {
+    if (!statsBuffer) return;
+
     DivergenceStats2D stats;
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
     glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(DivergenceStats2D), &stats);
@@ -408,6 +2234,8 @@ void debugPrintMarginals(void) {
 }
 
 void printStats2DTable(void) {
+    if (!statsBuffer) return;
+
     DivergenceStats2D stats;
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
     glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(DivergenceStats2D), &stats);
@@ -580,68 +2408,113 @@ void createFontTexture(void) {
     free(pixels);
 }
 
+// GL_ARB_buffer_storage (core in 4.4, not in the bundled glad)
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT   0x0080
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// The glyph buffer is HUD_FRAMES slices, one per frame in flight, each drawn
+// with one instanced call (six vertices per glyph). With buffer storage it is
+// persistently mapped and hudText() writes straight into the slice; otherwise
+// glyphs go to hud.staging and hudFlush() uploads them with one glBufferSubData.
 void createTextBuffers(void) {
-    glGenVertexArrays(1, &textVAO);
-    glGenBuffers(1, &textVBO);
-    glBindVertexArray(textVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4 * 256, NULL, GL_DYNAMIC_DRAW);
+    GLsizeiptr size = (GLsizeiptr)sizeof(HudGlyph) * HUD_MAX_GLYPHS * HUD_FRAMES;
+    glGenVertexArrays(1, &hud.vao);
+    glGenBuffers(1, &hud.vbo);
+    glBindVertexArray(hud.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, hud.vbo);
+
+    PFNGLBUFFERSTORAGEPROC bufferStorage = NULL;
+    if (glfwExtensionSupported("GL_ARB_buffer_storage")) {
+        bufferStorage = (PFNGLBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+    }
+    if (bufferStorage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        bufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+        hud.mapped = (HudGlyph*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+    }
+    if (!hud.mapped) {
+        glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+    }
+
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(HudGlyph), (void*)offsetof(HudGlyph, x));
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-}
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(HudGlyph), (void*)offsetof(HudGlyph, glyph));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HudGlyph), (void*)offsetof(HudGlyph, color));
+    for (int i = 0; i < 3; i++) glVertexAttribDivisor(i, 1);
 
-void renderText(const char* text, float x, float y, float scale, float r, float g, float b) {
-    glUseProgram(textProgram);
-    glUniform2f(glGetUniformLocation(textProgram, "screenSize"), (float)WINDOW_WIDTH, (float)WINDOW_HEIGHT);
-    glUniform3f(glGetUniformLocation(textProgram, "textColor"), r, g, b);
+    GLint screenSizeLoc = glGetUniformLocation(textProgram, "screenSize");
+    glProgramUniform2f(textProgram, screenSizeLoc, (float)WINDOW_WIDTH, (float)WINDOW_HEIGHT);
+}
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, fontTexture);
-    glUniform1i(glGetUniformLocation(textProgram, "fontTex"), 0);
+void destroyTextBuffers(void) {
+    for (int i = 0; i < HUD_FRAMES; i++) {
+        if (hud.fences[i]) glDeleteSync(hud.fences[i]);
+        hud.fences[i] = 0;
+    }
+    if (hud.mapped) {
+        glBindBuffer(GL_ARRAY_BUFFER, hud.vbo);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        hud.mapped = NULL;
+    }
+    glDeleteVertexArrays(1, &hud.vao);
+    glDeleteBuffers(1, &hud.vbo);
+}
 
-    glBindVertexArray(textVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
+// Queue text at window pixel (x, y), top-left origin; drawn by hudFlush()
+void hudText(const char* text, float x, float y, float scale, float r, float g, float b) {
+    HudGlyph* glyphs = hud.staging;
+    if (hud.mapped) {
+        // First glyph of the frame: the GPU must be done with this slice's last draw
+        if (hud.count == 0 && hud.fences[hud.slice]) {
+            glClientWaitSync(hud.fences[hud.slice], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+            glDeleteSync(hud.fences[hud.slice]);
+            hud.fences[hud.slice] = 0;
+        }
+        glyphs = hud.mapped + hud.slice * HUD_MAX_GLYPHS;
+    }
 
-    float vertices[6 * 4 * 256];
-    int vertexCount = 0;
+    uint32_t color = (uint32_t)(r * 255.0f + 0.5f) | (uint32_t)(g * 255.0f + 0.5f) << 8 |
+                     (uint32_t)(b * 255.0f + 0.5f) << 16 | 0xFF000000u;
     float charW = 8.0f * scale;
-    float charH = 8.0f * scale;
-
-    for (int i = 0; text[i] && i < 256; i++) {
+    for (int i = 0; text[i] && hud.count < HUD_MAX_GLYPHS; i++) {
         char c = text[i];
         if (c < 32 || c > 127) c = '?';
-        int idx = c - 32;
-
-        float u0 = (idx % 16) * 8.0f / 128.0f;
-        float v0 = (idx / 16) * 8.0f / 64.0f;
-        float u1 = u0 + 8.0f / 128.0f;
-        float v1 = v0 + 8.0f / 64.0f;
-
-        float x0 = x + i * charW;
-        float y0 = y;
-        float x1 = x0 + charW;
-        float y1 = y0 + charH;
-
-        float quad[24] = {
-            x0, y0, u0, v0,
-            x1, y0, u1, v0,
-            x1, y1, u1, v1,
-            x0, y0, u0, v0,
-            x1, y1, u1, v1,
-            x0, y1, u0, v1,
-        };
-        memcpy(vertices + vertexCount * 24, quad, sizeof(quad));
-        vertexCount++;
+        if (c == ' ') continue;  // Blank cell
+        HudGlyph* glyph = &glyphs[hud.count++];
+        glyph->x = x + i * charW;
+        glyph->y = y;
+        glyph->scale = scale;
+        glyph->glyph = (uint32_t)(c - 32);
+        glyph->color = color;
     }
+}
 
-    glBufferSubData(GL_ARRAY_BUFFER, 0, vertexCount * 24 * sizeof(float), vertices);
+// Draw every glyph queued this frame with one instanced call and move on to the next slice
+void hudFlush(void) {
+    if (hud.count == 0) return;
+    GLintptr offset = (GLintptr)hud.slice * HUD_MAX_GLYPHS * sizeof(HudGlyph);
+    if (!hud.mapped) {
+        glBindBuffer(GL_ARRAY_BUFFER, hud.vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, offset, hud.count * sizeof(HudGlyph), hud.staging);
+    }
 
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "HUD");
+    glUseProgram(textProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, fontTexture);
+    glBindVertexArray(hud.vao);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDrawArrays(GL_TRIANGLES, 0, vertexCount * 6);
+    glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 6, hud.count, (GLuint)(hud.slice * HUD_MAX_GLYPHS));
     glDisable(GL_BLEND);
+    glPopDebugGroup();
+
+    if (hud.mapped) hud.fences[hud.slice] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    hud.slice = (hud.slice + 1) % HUD_FRAMES;
+    hud.count = 0;
 }
 
 void createQuad(void) {
@@ -654,25 +2527,748 @@ void createQuad(void) {
          1.0f,  1.0f,  1.0f, 1.0f
     };
 
-    glGenVertexArrays(1, &quadVAO);
-    glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    glGenVertexArrays(1, &quadVAO);
+    glGenBuffers(1, &quadVBO);
+    glBindVertexArray(quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+}
+
+// Largest speed the queued splats can add at one face: overlapping capsules
+// add their forces, and the force shaders clamp the result to MAX_VELOCITY
+float queuedSplatSpeed(void) {
+    float speed = 0.0f;
+    for (int i = 0; i < numQueuedSplats; i++) {
+        speed += fmaxf(fabsf(splatQueue[i].force[0]), fabsf(splatQueue[i].force[1]));
+    }
+    return fminf(speed, MAX_VELOCITY);
+}
+
+// Queue a mouse stroke segment from (x0, y0) to (x1, y1) in normalized
+// cell-center space. Once the queue is full, later events extend the last
+// segment and add to its force, so no input is dropped.
+void queueSplat(float x0, float y0, float x1, float y1) {
+    // Convert the normalized per-event delta to grid-space velocity (grid cells per second)
+    float forceScale = 100.0f * SIM_WIDTH;  // Scale factor for force (reduced from 300)
+    float fx = (x1 - x0) * forceScale;
+    float fy = (y1 - y0) * forceScale;
+
+    if (numQueuedSplats == MAX_SPLATS) {
+        Splat* last = &splatQueue[MAX_SPLATS - 1];
+        last->end[0] = x1;
+        last->end[1] = y1;
+        last->force[0] += fx;
+        last->force[1] += fy;
+        return;
+    }
+
+    // Generate color based on direction
+    float angle = atan2f(fy, fx);
+    Splat* s = &splatQueue[numQueuedSplats++];
+    memset(s, 0, sizeof(*s));
+    s->start[0] = x0;
+    s->start[1] = y0;
+    s->end[0] = x1;
+    s->end[1] = y1;
+    s->force[0] = fx;
+    s->force[1] = fy;
+    s->color[0] = 0.5f + 0.5f * cosf(angle);
+    s->color[1] = 0.5f + 0.5f * cosf(angle + 2.094f);  // 120 degrees
+    s->color[2] = 0.5f + 0.5f * cosf(angle + 4.189f);  // 240 degrees
+}
+
+// Fill the per-frame constants and upload them in one call. The splats
+// themselves live in the SplatQueue buffer and are only read by the force passes.
+void updateFrameParams(float dt) {
+    FrameParams* p = &frameParams;
+    p->dt = dt;
+    p->velocityDissipation = 1.0f;
+    p->densityDissipation = 0.999f;
+    p->splatCount = numQueuedSplats;
+    p->splatRadius = splatRadius;
+    p->splatCutoff = splatCutoffDistance(splatRadius, splatThreshold);
+    p->tileVelocityEpsilon = tileVelocityEpsilon;
+    p->tileDensityEpsilon = tileDensityEpsilon;
+    p->tileMargin = tileMargin;
+    p->solveTolerance = solveTolerance;
+    p->velocityBacktraceOrder = velocityBacktraceOrder;
+    p->densityBacktraceOrder = densityBacktraceOrder;
+
+    // The farthest a trace reaches, plus a cell for the bilinear footprint
+    // across the staggered offset
+    advectHalo = (int)ceilf(estimateMaxSpeed() * dt) + 1;
+    if (advectHalo > ADVECT_HALO_MAX) advectHalo = ADVECT_HALO_MAX;
+    p->advectHalo = advectHalo;
+
+    uploadFrameParams(p);
+}
+
+// Resource labels for the frame graph printout
+static const char* uNames[2] = {"u[0]", "u[1]"};
+static const char* vNames[2] = {"v[0]", "v[1]"};
+static const char* densityNames[2] = {"density[0]", "density[1]"};
+
+// Zero a cell-centered R32F field (access 0)
+static void clearFieldPass(const FGPass* pass) {
+    clearTextureR(pass->access[0].object);
+}
+
+static void clearStatsPass(const FGPass* pass) {
+    clearStats2D();
+}
+
+static void uploadSplatsPass(const FGPass* pass) {
+    uploadSplats(splatQueue, numQueuedSplats);
+}
+
+// Mark every tile as retiring so the first tiled frame zeroes whatever the
+// skipped tiles hold in both ping-pong buffers
+static void resetTilesPass(const FGPass* pass) {
+    GLuint retireFrames = 2;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileFlagsBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &retireFrames);
+}
+
+// Indirect pass over the active (TILE_ACTIVE_COMMAND) or retiring (TILE_RETIRE_COMMAND) tiles
+FGPass* addTilePass(FrameGraph* g, const char* name, const ComputePipeline* pipeline, GLintptr command) {
+    FGPass* p = fgAddIndirectPass(g, name, pipeline, "tileList", tileListBuffer, command);
+    fgStorageRead(p, TILE_LIST_BINDING, "tileList", tileListBuffer);
+    return p;
+}
+
+// Full-grid pass, or an indirect pass over the active tiles when tiled
+FGPass* addGridPass(FrameGraph* g, const char* name, const ComputePipeline* pipeline,
+                    int width, int height, int tiled) {
+    if (tiled) return addTilePass(g, name, pipeline, TILE_ACTIVE_COMMAND);
+    return fgAddPass(g, name, pipeline, width, height);
+}
+
+// Rebuild the active-tile lists from the current state and zero the retiring
+// tiles in this frame's advection outputs
+void addTilePasses(FrameGraph* g, int vel, int density) {
+    FGPass* p;
+
+    if (!tileStateValid) {
+        p = fgAddHostPass(g, "Reset Tiles", resetTilesPass);
+        fgBufferUpdate(p, "tileFlags", tileFlagsBuffer);
+        tileStateValid = 1;
+    }
+
+    p = fgAddPass(g, "Tile Mask", &tileMaskPipeline, TILES_X * TILE_SIZE, TILES_Y * TILE_SIZE);
+    fgImage(p, 0, uNames[vel], uVelocityTex[vel], FG_IMAGE_READ, VELOCITY_FORMAT);
+    fgImage(p, 1, vNames[vel], vVelocityTex[vel], FG_IMAGE_READ, VELOCITY_FORMAT);
+    fgImage(p, 2, densityNames[density], densityTex[density], FG_IMAGE_READ, DENSITY_FORMAT);
+    fgStorage(p, TILE_LIST_BINDING, "tileList", tileListBuffer);
+    fgStorage(p, TILE_FLAGS_BINDING, "tileFlags", tileFlagsBuffer);
+
+    p = fgAddPass(g, "Tile Compact", &tileCompactPipeline, TILE_COUNT, 1);
+    fgStorage(p, TILE_LIST_BINDING, "tileList", tileListBuffer);
+    fgStorage(p, TILE_FLAGS_BINDING, "tileFlags", tileFlagsBuffer);
+
+    p = addTilePass(g, "Retire Tiles", &tileClearPipeline, TILE_RETIRE_COMMAND);
+    fgImage(p, 0, uNames[1 - vel], uVelocityTex[1 - vel], FG_IMAGE_WRITE, VELOCITY_FORMAT);
+    fgImage(p, 1, vNames[1 - vel], vVelocityTex[1 - vel], FG_IMAGE_WRITE, VELOCITY_FORMAT);
+    fgImage(p, 2, densityNames[1 - density], densityTex[1 - density], FG_IMAGE_WRITE, DENSITY_FORMAT);
+}
+
+// Advected fields (addFieldAdvection)
+#define ADVECT_FIELD_DENSITY 0
+#define ADVECT_FIELD_U       1
+#define ADVECT_FIELD_V       2
+
+// Pass labels by field and stage + 1 (0: plain semi-Lagrangian)
+static const char* advectPassNames[3][ADVECT_STAGES + 1] = {
+    {"Advect Density", "Predict Density", "Correct Density", "BFECC Error Density", "BFECC Density"},
+    {"Advect U", "Predict U", "Correct U", "BFECC Error U", "BFECC U"},
+    {"Advect V", "Predict V", "Correct V", "BFECC Error V", "BFECC V"},
+};
+static const char* advectHatNames[3] = {"densityHat", "uHat", "vHat"};
+static const char* advectTildeNames[3] = {"densityTilde", "uTilde", "vTilde"};
+
+// Zero an advection intermediate (access 0) of pass->width x pass->height
+static void clearAdvectedPass(const FGPass* pass) {
+    const FGAccess* a = &pass->access[0];
+    fillTexture(a->format == DENSITY_FORMAT ? &fillRGBA32FPipeline : &fillR32FPipeline, a->object,
+                pass->width, pass->height, NULL, 0.0f);
+}
+
+// One advection kernel of a field, tracing through velocity[vel]: the plain
+// semi-Lagrangian build for stage < 0, else an ADVECT_STAGE_* build. Those read
+// the field at the start of the step as well as advected, the intermediate the
+// stage before wrote (0 for the predictor).
+FGPass* addAdvectPass(FrameGraph* g, int field, int stage, int vel, int density,
+                      GLuint advected, const char* advectedName, GLuint out, const char* outName, int tiled) {
+    const char* name = advectPassNames[field][stage + 1];
+    FGPass* p;
+    if (field == ADVECT_FIELD_DENSITY) {
+        // Velocity via images (discrete positions), density via sampler (bilinear backtrace)
+        p = addGridPass(g, name, stage < 0 ? &advectDensityPipeline : &advectDensityStagePipelines[stage],
+                        SIM_WIDTH, SIM_HEIGHT, tiled);
+        fgImage(p, 0, uNames[vel], uVelocityTex[vel], FG_IMAGE_READ, VELOCITY_FORMAT);
+        fgImage(p, 1, vNames[vel], vVelocityTex[vel], FG_IMAGE_READ, VELOCITY_FORMAT);
+        fgImage(p, 2, outName, out, FG_IMAGE_WRITE, DENSITY_FORMAT);
+        fgSampler(p, 0, densityNames[density], densityTex[density]);
+        if (advected) fgSampler(p, 1, advectedName, advected);
+        return p;
+    }
+    if (field == ADVECT_FIELD_U) {
+        p = addGridPass(g, name, stage < 0 ? &advectUPipeline : &advectUStagePipelines[stage],
+                        U_WIDTH, U_HEIGHT, tiled);
+    } else {
+        p = addGridPass(g, name, stage < 0 ? &advectVPipeline : &advectVStagePipelines[stage],
+                        V_WIDTH, V_HEIGHT, tiled);
+    }
+    fgSampler(p, 0, uNames[vel], uVelocityTex[vel]);
+    fgSampler(p, 1, vNames[vel], vVelocityTex[vel]);
+    fgImage(p, 0, outName, out, FG_IMAGE_WRITE, VELOCITY_FORMAT);
+    if (advected) fgSampler(p, 2, advectedName, advected);
+    return p;
+}
+
+// Transient for a MacCormack/BFECC intermediate of a field. The correction
+// stages sample it a backtrace away from the texel they write, which can fall
+// in a tile no stage ran on, so when tiled it starts out zeroed like the state
+// in those tiles.
+static GLuint acquireAdvected(FrameGraph* g, int field, const char* name, int tiled) {
+    GLenum format = field == ADVECT_FIELD_DENSITY ? DENSITY_FORMAT : VELOCITY_FORMAT;
+    int width = field == ADVECT_FIELD_U ? U_WIDTH : SIM_WIDTH;
+    int height = field == ADVECT_FIELD_V ? V_HEIGHT : SIM_HEIGHT;
+    GLuint tex = acquireTransient(name, format, width, height, GL_LINEAR);
+    if (tiled) {
+        FGPass* p = fgAddHostPass(g, "Clear Intermediate", clearAdvectedPass);
+        p->width = width;
+        p->height = height;
+        fgImage(p, 0, name, tex, FG_IMAGE_WRITE, format);
+    }
+    return tex;
+}
+
+// Advect a field from the start of the step into out with advectionScheme
+void addFieldAdvection(FrameGraph* g, int field, int vel, int density, GLuint out, const char* outName,
+                       int tiled) {
+    if (advectionScheme == ADVECTION_SEMI_LAGRANGIAN) {
+        addAdvectPass(g, field, -1, vel, density, 0, NULL, out, outName, tiled);
+        return;
+    }
+
+    const char* hatName = advectHatNames[field];
+    GLuint hat = acquireAdvected(g, field, hatName, tiled);
+    addAdvectPass(g, field, ADVECT_STAGE_PREDICT, vel, density, 0, NULL, hat, hatName, tiled);
+    if (advectionScheme == ADVECTION_MACCORMACK) {
+        addAdvectPass(g, field, ADVECT_STAGE_MACCORMACK, vel, density, hat, hatName, out, outName, tiled);
+    } else {
+        const char* tildeName = advectTildeNames[field];
+        GLuint tilde = acquireAdvected(g, field, tildeName, tiled);
+        addAdvectPass(g, field, ADVECT_STAGE_BFECC_ERROR, vel, density, hat, hatName, tilde, tildeName, tiled);
+        addAdvectPass(g, field, ADVECT_STAGE_BFECC_FINAL, vel, density, tilde, tildeName, out, outName, tiled);
+        releaseTransient(tilde);
+    }
+    releaseTransient(hat);
+}
+
+// Pass labels of the fused velocity kernel by stage + 1
+static const char* advectVelocityPassNames[ADVECT_STAGES + 1] = {
+    "Advect Velocity", "Predict Velocity", "Correct Velocity", "BFECC Error Velocity", "BFECC Velocity",
+};
+
+// One stage of the fused velocity kernel: both components through velocity[vel]
+// into out[0] (u) and out[1] (v), reading the intermediates advected[0] and
+// advected[1] (NULL for the predictor and the plain step)
+FGPass* addAdvectVelocityPass(FrameGraph* g, int stage, int vel, const GLuint* advected,
+                              const char* const* advectedNames, const GLuint* out, const char* const* outNames,
+                              int tiled) {
+    FGPass* p = addGridPass(g, advectVelocityPassNames[stage + 1],
+                            stage < 0 ? &advectVelocityPipeline : &advectVelocityStagePipelines[stage],
+                            U_WIDTH, V_HEIGHT, tiled);
+    fgSampler(p, 0, uNames[vel], uVelocityTex[vel]);
+    fgSampler(p, 1, vNames[vel], vVelocityTex[vel]);
+    fgImage(p, 0, outNames[0], out[0], FG_IMAGE_WRITE, VELOCITY_FORMAT);
+    fgImage(p, 1, outNames[1], out[1], FG_IMAGE_WRITE, VELOCITY_FORMAT);
+    if (advected) {
+        fgSampler(p, 2, advectedNames[0], advected[0]);
+        fgSampler(p, 3, advectedNames[1], advected[1]);
+    }
+    return p;
+}
+
+// Advect u and v from the start of the step into velocity[1 - vel] with
+// advectionScheme: one fused pass per stage, or each component on its own
+// without fusedVelocityAdvection
+void addVelocityAdvection(FrameGraph* g, int vel, int density, int tiled) {
+    if (!fusedVelocityAdvection) {
+        addFieldAdvection(g, ADVECT_FIELD_U, vel, density, uVelocityTex[1 - vel], uNames[1 - vel], tiled);
+        addFieldAdvection(g, ADVECT_FIELD_V, vel, density, vVelocityTex[1 - vel], vNames[1 - vel], tiled);
+        return;
+    }
+
+    GLuint out[2] = {uVelocityTex[1 - vel], vVelocityTex[1 - vel]};
+    const char* outNames[2] = {uNames[1 - vel], vNames[1 - vel]};
+    if (advectionScheme == ADVECTION_SEMI_LAGRANGIAN) {
+        addAdvectVelocityPass(g, -1, vel, NULL, NULL, out, outNames, tiled);
+        return;
+    }
+
+    const char* hatNames[2] = {advectHatNames[ADVECT_FIELD_U], advectHatNames[ADVECT_FIELD_V]};
+    GLuint hat[2] = {acquireAdvected(g, ADVECT_FIELD_U, hatNames[0], tiled),
+                     acquireAdvected(g, ADVECT_FIELD_V, hatNames[1], tiled)};
+    addAdvectVelocityPass(g, ADVECT_STAGE_PREDICT, vel, NULL, NULL, hat, hatNames, tiled);
+    if (advectionScheme == ADVECTION_MACCORMACK) {
+        addAdvectVelocityPass(g, ADVECT_STAGE_MACCORMACK, vel, hat, hatNames, out, outNames, tiled);
+    } else {
+        const char* tildeNames[2] = {advectTildeNames[ADVECT_FIELD_U], advectTildeNames[ADVECT_FIELD_V]};
+        GLuint tilde[2] = {acquireAdvected(g, ADVECT_FIELD_U, tildeNames[0], tiled),
+                           acquireAdvected(g, ADVECT_FIELD_V, tildeNames[1], tiled)};
+        addAdvectVelocityPass(g, ADVECT_STAGE_BFECC_ERROR, vel, hat, hatNames, tilde, tildeNames, tiled);
+        addAdvectVelocityPass(g, ADVECT_STAGE_BFECC_FINAL, vel, tilde, tildeNames, out, outNames, tiled);
+        releaseTransient(tilde[0]);
+        releaseTransient(tilde[1]);
+    }
+    releaseTransient(hat[0]);
+    releaseTransient(hat[1]);
+}
+
+// Zero velocity and set a 4x4 impulse of u = 1 at center (access 0 = u, access 1 = v)
+static void debugImpulsePass(const FGPass* pass) {
+    int cx = SIM_WIDTH / 2 - 2;
+    int cy = SIM_HEIGHT / 2 - 2;
+    int impulse[4] = {cx, cy, cx + 4, cy + 4};
+    fillTexture(&fillR32FPipeline, pass->access[0].object, U_WIDTH, U_HEIGHT, impulse, 1.0f);
+    clearTextureV(pass->access[1].object);
+}
+
+// Sweep mode shared by the interior and boundary builds of pressure.comp
+static void setPressureMode(int trackResidual, int tileDispatch) {
+    glProgramUniform1i(pressurePipeline.program, pressureTrackResidualLoc, trackResidual);
+    glProgramUniform1i(pressureInteriorPipeline.program, pressureInteriorTrackResidualLoc, trackResidual);
+    glProgramUniform1i(pressurePipeline.program, pressurePipeline.tileDispatchLoc, tileDispatch);
+    glProgramUniform1i(pressureInteriorPipeline.program, pressureInteriorPipeline.tileDispatchLoc, tileDispatch);
+}
+
+// One red + black sweep over the whole grid, or over the active set (indirect).
+// Interior and boundary tiles of a half-sweep are independent, so only the
+// half-sweeps are separated by barriers. Full sweeps that do not record
+// residuals run the interior with the DENSE build and its tuned work group.
+static void pressureSweep(const FGPass* pass, int indirect, int trackResidual) {
+    for (int red = 1; red >= 0; red--) {
+        if (indirect) {
+            glUseProgram(pressureInteriorPipeline.program);
+            glUniform1i(pressureInteriorRedPassLoc, red);
+            glDispatchComputeIndirect(SOLVE_INTERIOR_COMMAND);
+        } else if (trackResidual) {
+            glUseProgram(pressureInteriorPipeline.program);
+            glUniform1i(pressureInteriorRedPassLoc, red);
+            dispatchInterior(&pressureInteriorPipeline, pass->width, pass->height);
+        } else {
+            glUseProgram(pressureDensePipeline.program);
+            glUniform1i(pressureDenseRedPassLoc, red);
+            dispatchInterior(&pressureDensePipeline, pass->width, pass->height);
+        }
+
+        glUseProgram(pressurePipeline.program);
+        glUniform1i(pressureRedPassLoc, red);
+        if (indirect) glDispatchComputeIndirect(SOLVE_BOUNDARY_COMMAND);
+        else dispatchRing(&pressurePipeline, pass->width, pass->height);
+
+        if (red) glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+}
+
+// Red-Black SOR: the half-sweeps depend on each other, so barriers are internal.
+// As an indirect pass it runs the active set: sweeps before the first check and
+// every solveCheckInterval-th sweep cover the grid and record tile residuals,
+// then pressure_compact.comp lists the unconverged tiles for the sweeps up to
+// the next check. Tiles that were skipped are re-measured by every check, so a
+// neighbour's change re-activates them.
+static void pressureSolvePass(const FGPass* pass) {
+    int activeSet = pass->indirectBuffer != 0;
+    int interval = solveCheckInterval > 1 ? solveCheckInterval : 1;
+    fgBindPass(pass);
+    setPressureMode(0, 0);
+    if (activeSet) {
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, solveListBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, solveListBuffer);
+        glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, SOLVE_SWEPT_OFFSET, sizeof(GLuint),
+                             GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    }
+    solveDenseSweeps = 0;
+
+    for (int i = 0; i < pressureIterations; i++) {
+        int check = activeSet && (i + 1) % interval == 0 && i + 1 < pressureIterations;
+        int indirect = activeSet && i >= interval && (i + 1) % interval != 0;
+        if (indirect) {
+            pressureSweep(pass, 1, 0);
+        } else {
+            if (activeSet) setPressureMode(check, 0);
+            pressureSweep(pass, 0, check);
+            solveDenseSweeps++;
+        }
+
+        if (check) {
+            // The list serves the sweeps up to the next check
+            int sweeps = pressureIterations - 1 - i;
+            if (sweeps > interval - 1) sweeps = interval - 1;
+            setPressureMode(0, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+            glUseProgram(pressureCompactPipeline.program);
+            glUniform1i(pressureCompactSweepsLoc, sweeps);
+            glDispatchCompute(1, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+        } else if (i < pressureIterations - 1) {
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
+    }
+}
+
+// Interior pass (INTERIOR build) and boundary ring pass of a split stencil kernel
+// over a width x height field. Returns the number of passes added; the caller
+// declares the same accesses on each.
+int addSplitPasses(FrameGraph* g, const char* name, const char* ringName, const ComputePipeline* interior,
+                   const ComputePipeline* boundary, int width, int height, FGPass* passes[2]) {
+    int rect[4];
+    int n = 0;
+    if (interiorRect(width, height, rect)) passes[n++] = fgAddRegionPass(g, name, interior, rect);
+    passes[n++] = fgAddRingPass(g, ringName, boundary, width, height);
+    for (int k = 0; k < n; k++) passes[k]->splitGroup = g->numPasses;
+    return n;
+}
+
+void addDivergencePass(FrameGraph* g, const char* name, int vel, GLuint outTex, const char* outName, int tiled) {
+    FGPass* p = addGridPass(g, name, tiled ? &divergencePipeline : &divergenceDensePipeline,
+                            SIM_WIDTH, SIM_HEIGHT, tiled);
+    fgImage(p, 0, uNames[vel], uVelocityTex[vel], FG_IMAGE_READ, VELOCITY_FORMAT);
+    fgImage(p, 1, vNames[vel], vVelocityTex[vel], FG_IMAGE_READ, VELOCITY_FORMAT);
+    fgImage(p, 2, outName, outTex, FG_IMAGE_WRITE, GL_R32F);
+}
+
+// Pre-divergence, pressure solve and gradient subtraction; returns the new velocity index.
+// Divergence and pressure go back to the transient pool once nothing else this frame
+// (stats, the current view) needs them.
+// When tiled, pre-divergence only runs on the active tiles plus the cells the splats
+// touched (splatRect, may be NULL); the solve and gradient subtraction stay global.
+int addProjectionPasses(FrameGraph* g, int vel, int tiled, const int* splatRect,
+                        int keepDivergence, int keepPressure) {
+    FGPass* p;
+
+    divergenceTex = acquireTransient("divergence", GL_R32F, SIM_WIDTH, SIM_HEIGHT, GL_NEAREST);
+    if (tiled) {
+        // The solve reads every cell; skipped tiles have zero velocity, hence zero divergence
+        p = fgAddHostPass(g, "Clear Divergence", clearFieldPass);
+        fgImage(p, 0, "divergence", divergenceTex, FG_IMAGE_WRITE, GL_R32F);
+    }
+    addDivergencePass(g, "Pre-Divergence", vel, divergenceTex, "divergence", tiled);
+    if (tiled && splatRect) {
+        p = fgAddRegionPass(g, "Pre-Divergence Splats", &divergencePipeline, splatRect);
+        fgImage(p, 0, uNames[vel], uVelocityTex[vel], FG_IMAGE_READ, VELOCITY_FORMAT);
+        fgImage(p, 1, vNames[vel], vVelocityTex[vel], FG_IMAGE_READ, VELOCITY_FORMAT);
+        fgImage(p, 2, "divergence", divergenceTex, FG_IMAGE_WRITE, GL_R32F);
+    }
+
+    pressureTex = acquireTransient("pressure", GL_R32F, SIM_WIDTH, SIM_HEIGHT, GL_LINEAR);
+    p = fgAddHostPass(g, "Clear Pressure", clearFieldPass);
+    fgImage(p, 0, "pressure", pressureTex, FG_IMAGE_WRITE, GL_R32F);
+
+    if (activeSetSolve) {
+        p = fgAddIndirectPass(g, "Pressure Solve", &pressurePipeline, "solveList", solveListBuffer, 0);
+        p->width = SIM_WIDTH;
+        p->height = SIM_HEIGHT;
+        fgBufferUpdate(p, "solveList", solveListBuffer);  // Swept-tile counter reset
+        fgStorage(p, SOLVE_LIST_BINDING, "solveList", solveListBuffer);
+        fgStorage(p, SOLVE_RESIDUAL_BINDING, "solveResidual", solveResidualBuffer);
+    } else {
+        p = fgAddPass(g, "Pressure Solve", &pressurePipeline, SIM_WIDTH, SIM_HEIGHT);
+    }
+    p->execute = pressureSolvePass;
+    fgImage(p, 0, "pressure", pressureTex, FG_IMAGE_READ_WRITE, GL_R32F);
+    fgImage(p, 1, "divergence", divergenceTex, FG_IMAGE_READ, GL_R32F);
+    if (!keepDivergence) releaseTransient(divergenceTex);
+
+    // Gradient subtraction (projection) - split into u (513x512) and v (512x513) passes,
+    // each an interior pass plus the boundary ring
+    FGPass* split[2];
+    int n = addSplitPasses(g, "Gradient Subtract U", "Gradient U Ring", &gradientSubtractUInteriorPipeline,
+                           &gradientSubtractUPipeline, U_WIDTH, U_HEIGHT, split);
+    for (int k = 0; k < n; k++) {
+        fgImage(split[k], 0, "pressure", pressureTex, FG_IMAGE_READ, GL_R32F);
+        fgImage(split[k], 1, uNames[vel], uVelocityTex[vel], FG_IMAGE_READ, VELOCITY_FORMAT);
+        fgImage(split[k], 2, uNames[1 - vel], uVelocityTex[1 - vel], FG_IMAGE_WRITE, VELOCITY_FORMAT);
+    }
+
+    n = addSplitPasses(g, "Gradient Subtract V", "Gradient V Ring", &gradientSubtractVInteriorPipeline,
+                       &gradientSubtractVPipeline, V_WIDTH, V_HEIGHT, split);
+    for (int k = 0; k < n; k++) {
+        fgImage(split[k], 0, "pressure", pressureTex, FG_IMAGE_READ, GL_R32F);
+        fgImage(split[k], 1, vNames[vel], vVelocityTex[vel], FG_IMAGE_READ, VELOCITY_FORMAT);
+        fgImage(split[k], 2, vNames[1 - vel], vVelocityTex[1 - vel], FG_IMAGE_WRITE, VELOCITY_FORMAT);
+    }
+    if (!keepPressure) releaseTransient(pressureTex);
+
+    return 1 - vel;
+}
+
+void addStatsPasses(FrameGraph* g) {
+    FGPass* p = fgAddHostPass(g, "Clear Stats", clearStatsPass);
+    fgBufferUpdate(p, "stats", statsBuffer);
+
+    p = fgAddPass(g, "Divergence Stats", &divergenceStatsPipeline, SIM_WIDTH, SIM_HEIGHT);
+    fgImage(p, 0, "divergence", divergenceTex, FG_IMAGE_READ, GL_R32F);
+    fgImage(p, 1, "postDivergence", postDivergenceTex, FG_IMAGE_READ, GL_R32F);
+    fgStorage(p, 0, "stats", statsBuffer);
+
+    // One work group; also appends to the history ring
+    p = fgAddPass(g, "Stats Summary", &statsSummaryPipeline, 1, 1);
+    fgStorageRead(p, 0, "stats", statsBuffer);
+    fgStorage(p, STATS_SUMMARY_BINDING, "statsSummary", statsSummaryBuffer);
+    fgStorage(p, STATS_HISTORY_BINDING, "statsHistory", statsHistoryBuffer);
+
+    // What the CPU knows about that entry, in the slot the GPU will use
+    StatsHistoryEntry* e = &statsHistoryEntries[statsHistoryWritten % HISTORY_FRAMES];
+    e->simFrame = simFrame;
+    e->time = glfwGetTime();
+    e->dt = frameParams.dt;
+    e->iterations = pressureIterations;
+    e->omega = pressureOmega;
+    e->sparseTiles = sparseTiles;
+    e->activeSetSolve = activeSetSolve;
+    e->debugTestMode = debugTestMode;
+    statsHistoryWritten++;
+}
+
+// Fused reduction of the projected state: one pass over the cell tiles writes
+// partials, one work group combines them into flowMetricsBuffer. Reads the
+// pre-divergence, which the projection must have kept.
+void addFlowMetricsPasses(FrameGraph* g, int vel, int density) {
+    // One work group per cell tile, whatever its shape
+    const ComputePipeline* metrics = &flowMetricsPipeline;
+    FGPass* p = fgAddPass(g, "Flow Metrics", metrics, SOLVE_TILES_X * metrics->localSize[0],
+                          SOLVE_TILES_Y * metrics->localSize[1]);
+    fgImage(p, 0, uNames[vel], uVelocityTex[vel], FG_IMAGE_READ, VELOCITY_FORMAT);
+    fgImage(p, 1, vNames[vel], vVelocityTex[vel], FG_IMAGE_READ, VELOCITY_FORMAT);
+    fgImage(p, 2, densityNames[density], densityTex[density], FG_IMAGE_READ, DENSITY_FORMAT);
+    fgImage(p, 3, "divergence", divergenceTex, FG_IMAGE_READ, GL_R32F);
+    fgStorage(p, FLOW_PARTIALS_BINDING, "flowPartials", flowPartialsBuffer);
+
+    // One work group
+    p = fgAddPass(g, "Flow Metrics Reduce", &flowMetricsReducePipeline, 1, 1);
+    fgStorageRead(p, FLOW_PARTIALS_BINDING, "flowPartials", flowPartialsBuffer);
+    fgStorage(p, FLOW_METRICS_BINDING, "flowMetrics", flowMetricsBuffer);
+}
+
+// Bounding rectangle (x0, y0, x1, y1; exclusive max) of the samples within the
+// truncation distance of any queued splat, for a width x height field whose sample
+// (i, j) sits at ((i + offsetX) / SIM_WIDTH, (j + offsetY) / SIM_HEIGHT).
+// Returns 0 if the rectangle is empty.
+int splatBounds(int width, int height, float offsetX, float offsetY, int rect[4]) {
+    float cutoff = frameParams.splatCutoff;
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+    for (int i = 0; i < numQueuedSplats; i++) {
+        const Splat* s = &splatQueue[i];
+        minX = fminf(minX, fminf(s->start[0], s->end[0]));
+        minY = fminf(minY, fminf(s->start[1], s->end[1]));
+        maxX = fmaxf(maxX, fmaxf(s->start[0], s->end[0]));
+        maxY = fmaxf(maxY, fmaxf(s->start[1], s->end[1]));
+    }
+    rect[0] = (int)floorf((minX - cutoff) * SIM_WIDTH - offsetX);
+    rect[1] = (int)floorf((minY - cutoff) * SIM_HEIGHT - offsetY);
+    rect[2] = (int)ceilf((maxX + cutoff) * SIM_WIDTH - offsetX) + 1;
+    rect[3] = (int)ceilf((maxY + cutoff) * SIM_HEIGHT - offsetY) + 1;
+    if (rect[0] < 0) rect[0] = 0;
+    if (rect[1] < 0) rect[1] = 0;
+    if (rect[2] > width) rect[2] = width;
+    if (rect[3] > height) rect[3] = height;
+    return rect[0] < rect[2] && rect[1] < rect[3];
+}
+
+// Grow the cell rectangle cells (x0, y0, x1, y1) to include rect, plus one cell
+// on every side for the stencils that read it
+static void growCellRect(int cells[4], const int rect[4]) {
+    if (rect[0] - 1 < cells[0]) cells[0] = rect[0] - 1 < 0 ? 0 : rect[0] - 1;
+    if (rect[1] - 1 < cells[1]) cells[1] = rect[1] - 1 < 0 ? 0 : rect[1] - 1;
+    if (rect[2] + 1 > cells[2]) cells[2] = rect[2] + 1 > SIM_WIDTH ? SIM_WIDTH : rect[2] + 1;
+    if (rect[3] + 1 > cells[3]) cells[3] = rect[3] + 1 > SIM_HEIGHT ? SIM_HEIGHT : rect[3] + 1;
+}
+
+// One dispatch per field applies every queued splat, however many events arrived.
+// Each dispatch only covers the splats' bounding rectangle on that field; the
+// cells whose divergence they can change are returned in cells. Returns 0 if
+// no splat reached the grid.
+int addForcePasses(FrameGraph* g, int vel, int density, int cells[4]) {
+    FGPass* p;
+    int rect[4];
+
+    cells[0] = SIM_WIDTH;
+    cells[1] = SIM_HEIGHT;
+    cells[2] = 0;
+    cells[3] = 0;
+
+    p = fgAddHostPass(g, "Upload Splats", uploadSplatsPass);
+    fgBufferUpdate(p, "splats", splatBuffer);
+
+    // u faces at (i, j + 0.5), v faces at (i + 0.5, j), dye at cell centers
+    if (splatBounds(U_WIDTH, U_HEIGHT, 0.0f, 0.5f, rect)) {
+        p = fgAddRegionPass(g, "Add Force U", &addForceUPipeline, rect);
+        fgImage(p, 0, uNames[vel], uVelocityTex[vel], FG_IMAGE_READ_WRITE, VELOCITY_FORMAT);
+        fgStorageRead(p, SPLAT_QUEUE_BINDING, "splats", splatBuffer);
+        growCellRect(cells, rect);
+    }
+
+    if (splatBounds(V_WIDTH, V_HEIGHT, 0.5f, 0.0f, rect)) {
+        p = fgAddRegionPass(g, "Add Force V", &addForceVPipeline, rect);
+        fgImage(p, 0, vNames[vel], vVelocityTex[vel], FG_IMAGE_READ_WRITE, VELOCITY_FORMAT);
+        fgStorageRead(p, SPLAT_QUEUE_BINDING, "splats", splatBuffer);
+        growCellRect(cells, rect);
+    }
+
+    if (splatBounds(SIM_WIDTH, SIM_HEIGHT, 0.5f, 0.5f, rect)) {
+        p = fgAddRegionPass(g, "Add Dye", &addForceDensityPipeline, rect);
+        fgImage(p, 0, densityNames[density], densityTex[density], FG_IMAGE_READ_WRITE, DENSITY_FORMAT);
+        fgStorageRead(p, SPLAT_QUEUE_BINDING, "splats", splatBuffer);
+    }
+    return cells[0] < cells[2] && cells[1] < cells[3];
+}
+
+// Everything render() samples, the stats for the convergence and history
+// overlays, and the stats, history, metrics, tile count and solve readbacks
+void addFrameExports(FrameGraph* g, int statsWritten, int metricsWritten, int tileCountRead,
+                     int solveCountRead) {
+    // The simulation thread copies the view into a present slot instead
+    FGAccessType view = simThreadRunning ? FG_TEXTURE_UPDATE : FG_SAMPLED;
+    fgExport(g, densityNames[currentDensity], densityTex[currentDensity], 0, view);
+    if (timestepMode == TIMESTEP_FIXED && interpolateRender) {
+        fgExport(g, densityNames[1 - currentDensity], densityTex[1 - currentDensity], 0, view);
+    }
+    fgExport(g, uNames[currentVel], uVelocityTex[currentVel], 0, view);
+    fgExport(g, vNames[currentVel], vVelocityTex[currentVel], 0, view);
+    if (displayMode == 2) fgExport(g, "divergence", divergenceTex, 0, view);
+    if (displayMode == 3) fgExport(g, "postDivergence", postDivergenceTex, 0, view);
+    if (displayMode == 4) fgExport(g, "pressure", pressureTex, 0, view);
+    if (statsWritten) {
+        fgExport(g, "stats", statsBuffer, 1, FG_BUFFER_UPDATE);
+        fgExport(g, "stats", statsBuffer, 1, FG_STORAGE_READ);
+        fgExport(g, "statsSummary", statsSummaryBuffer, 1, FG_STORAGE_READ);
+        fgExport(g, "statsHistory", statsHistoryBuffer, 1, FG_BUFFER_UPDATE);
+        fgExport(g, "statsHistory", statsHistoryBuffer, 1, FG_STORAGE_READ);
+    }
+    if (metricsWritten) fgExport(g, "flowMetrics", flowMetricsBuffer, 1, FG_BUFFER_UPDATE);
+    if (tileCountRead) fgExport(g, "tileList", tileListBuffer, 1, FG_BUFFER_UPDATE);
+    if (solveCountRead) fgExport(g, "solveList", solveListBuffer, 1, FG_BUFFER_UPDATE);
+}
+
+// Copy this frame's metrics into the next readback slot behind a fence. If all
+// slots are still in flight the GPU is far behind; skip rather than wait.
+void queueFlowMetricsReadback(void) {
+    MetricsReadback* r = &metricsReadback;
+    int slot = r->next;
+    if (r->fences[slot]) {
+        r->dropped++;
+        return;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, flowMetricsBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, r->buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, slot * sizeof(FlowMetrics),
+                        sizeof(FlowMetrics));
+    r->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    r->frames[slot] = simFrame;
+    r->dts[slot] = frameParams.dt;
+    r->next = (slot + 1) % METRICS_READBACK_FRAMES;
+}
+
+// Take every slot whose copy has finished, oldest first, without blocking;
+// flowMetrics ends up holding the newest
+void pollFlowMetrics(void) {
+    MetricsReadback* r = &metricsReadback;
+    for (int k = 0; k < METRICS_READBACK_FRAMES; k++) {
+        int slot = (r->next + k) % METRICS_READBACK_FRAMES;
+        if (!r->fences[slot]) continue;
+        GLenum status = glClientWaitSync(r->fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+        glDeleteSync(r->fences[slot]);
+        r->fences[slot] = 0;
+        glBindBuffer(GL_COPY_READ_BUFFER, r->buffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, slot * sizeof(FlowMetrics), sizeof(FlowMetrics), &flowMetrics);
+        flowMetricsFrame = r->frames[slot];
+        flowMetricsDt = r->dts[slot];
+        flowMetricsValid = 1;
+    }
+}
+
+// Copy the active-tile count and the swept-tile counter of this frame into the
+// next counter slot behind a fence. Neither read: the HUD shows no count. All
+// slots in flight: skip, the HUD keeps the last values.
+void queueCounterReadback(int tilesRead, int solveRead) {
+    CounterReadback* r = &counterReadback;
+    if (!tilesRead && !solveRead) {
+        activeTileCount = -1;
+        solveSweptFraction = -1.0f;
+        return;
+    }
+    int slot = r->next;
+    if (r->fences[slot]) return;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, r->buffer);
+    if (tilesRead) {
+        glBindBuffer(GL_COPY_READ_BUFFER, tileListBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, TILE_ACTIVE_COMMAND,
+                            slot * COUNTER_SLOT_BYTES + COUNTER_ACTIVE_TILES * sizeof(GLuint), sizeof(GLuint));
+    }
+    if (solveRead) {
+        glBindBuffer(GL_COPY_READ_BUFFER, solveListBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, SOLVE_SWEPT_OFFSET,
+                            slot * COUNTER_SLOT_BYTES + COUNTER_SWEPT_TILES * sizeof(GLuint), sizeof(GLuint));
+    }
+    r->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    r->tilesRead[slot] = tilesRead;
+    r->denseSweeps[slot] = solveRead ? solveDenseSweeps : -1;
+    r->sweeps[slot] = pressureIterations;
+    r->next = (slot + 1) % METRICS_READBACK_FRAMES;
+}
+
+// Take every counter slot whose copy has finished, oldest first, without blocking
+void pollCounters(void) {
+    CounterReadback* r = &counterReadback;
+    for (int k = 0; k < METRICS_READBACK_FRAMES; k++) {
+        int slot = (r->next + k) % METRICS_READBACK_FRAMES;
+        if (!r->fences[slot]) continue;
+        GLenum status = glClientWaitSync(r->fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+        glDeleteSync(r->fences[slot]);
+        r->fences[slot] = 0;
+        GLuint counters[2];
+        glBindBuffer(GL_COPY_READ_BUFFER, r->buffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, slot * COUNTER_SLOT_BYTES, COUNTER_SLOT_BYTES, counters);
+        activeTileCount = r->tilesRead[slot] ? (int)counters[COUNTER_ACTIVE_TILES] : -1;
+        solveSweptFraction = -1.0f;
+        if (r->denseSweeps[slot] >= 0 && r->sweeps[slot] > 0) {
+            solveSweptFraction = ((float)r->denseSweeps[slot] * SOLVE_TILE_COUNT + counters[COUNTER_SWEPT_TILES]) /
+                                 ((float)r->sweeps[slot] * SOLVE_TILE_COUNT);
+        }
+    }
 }
 
 void simulate(float dt) {
-    // Dispatch sizes for different grid dimensions
-    int groupsX = (SIM_WIDTH + 15) / 16;       // 32 for 512
-    int groupsY = (SIM_HEIGHT + 15) / 16;      // 32 for 512
-    int uGroupsX = (U_WIDTH + 15) / 16;        // 33 for 513
-    int uGroupsY = (U_HEIGHT + 15) / 16;       // 32 for 512
-    int vGroupsX = (V_WIDTH + 15) / 16;        // 32 for 512
-    int vGroupsY = (V_HEIGHT + 15) / 16;       // 33 for 513
+    // Metrics and HUD counters copied during earlier frames, if they have landed
+    pollFlowMetrics();
+    pollCounters();
+
+    hostUploadBytes = 0;
+    updateFrameParams(dt);
+    beginTransientFrame();
+
+    FrameGraph* g = &frameGraph;
+    fgBegin(g);
+
+    // Passes are declared against the ping-pong indices they will see when they
+    // run; the indices advance here and the graph executes afterwards
+    int vel = currentVel;
+    int density = currentDensity;
+    int runStats;
+    int tiled = 0;
+    FGPass* p;
+
+    // Only the texture on screen outlives its last pass
+    postDivergenceTex = 0;
 
     if (debugTestMode) {
         // === DEBUG TEST MODE ===
@@ -681,347 +3277,376 @@ void simulate(float dt) {
         // 2. Set a single point impulse at center (creates known divergence)
         // 3. Run pressure solve and projection
         // 4. Observe pre vs post divergence
-
         glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Debug Test Mode");
 
-        // 1. Clear velocity to zero (using proper MAC grid sizes)
-        clearTextureU(uVelocityTex[currentVel]);
-        clearTextureV(vVelocityTex[currentVel]);
-
-        // 2. Set a 4x4 impulse at center
-        int cx = SIM_WIDTH / 2 - 2;
-        int cy = SIM_HEIGHT / 2 - 2;
-        float uImpulse[4 * 4];  // 4x4 pixels, u component
-        float vImpulse[4 * 4];  // 4x4 pixels, v component
-        for (int i = 0; i < 4 * 4; i++) {
-            uImpulse[i] = 1.0f;  // u velocity
-            vImpulse[i] = 0.0f;  // v velocity
-        }
-        glBindTexture(GL_TEXTURE_2D, uVelocityTex[currentVel]);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, cx, cy, 4, 4, GL_RED, GL_FLOAT, uImpulse);
-        glBindTexture(GL_TEXTURE_2D, vVelocityTex[currentVel]);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, cx, cy, 4, 4, GL_RED, GL_FLOAT, vImpulse);
-        // Ensure texture update is visible to compute shader image loads
-        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
-        // 3. Compute pre-divergence
-        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Pre-Divergence");
-        glUseProgram(divergenceProgram);
-        glBindImageTexture(0, uVelocityTex[currentVel], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-        glBindImageTexture(1, vVelocityTex[currentVel], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-        glBindImageTexture(2, divergenceTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
-        glDispatchCompute(groupsX, groupsY, 1);
-        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-        glPopDebugGroup();
+        p = fgAddHostPass(g, "Impulse", debugImpulsePass);
+        fgImage(p, 0, uNames[vel], uVelocityTex[vel], FG_IMAGE_WRITE, VELOCITY_FORMAT);
+        fgImage(p, 0, vNames[vel], vVelocityTex[vel], FG_IMAGE_WRITE, VELOCITY_FORMAT);
 
-        // 4. Pressure solve
-        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Pressure Solve");
-        clearTextureR(pressureTex[currentPressure]);
-        glUseProgram(pressureProgram);
-        glUniform1f(glGetUniformLocation(pressureProgram, "omega"), pressureOmega);
-        glBindImageTexture(0, pressureTex[currentPressure], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
-        glBindImageTexture(1, divergenceTex, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-
-        for (int i = 0; i < pressureIterations; i++) {
-            glUniform1i(glGetUniformLocation(pressureProgram, "redPass"), 1);
-            glDispatchCompute(groupsX, groupsY, 1);
-            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-            glUniform1i(glGetUniformLocation(pressureProgram, "redPass"), 0);
-            glDispatchCompute(groupsX, groupsY, 1);
-            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-        }
-        glPopDebugGroup();
+        vel = addProjectionPasses(g, vel, 0, NULL, 1, displayMode == 4);
 
-        // 5. Gradient subtraction (projection) - split into u and v passes
-        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Gradient Subtract");
-
-        // Gradient subtract for u (513x512)
-        glUseProgram(gradientSubtractUProgram);
-        glUniform2i(glGetUniformLocation(gradientSubtractUProgram, "uSize"), U_WIDTH, U_HEIGHT);
-        glUniform2i(glGetUniformLocation(gradientSubtractUProgram, "pressSize"), SIM_WIDTH, SIM_HEIGHT);
-        glBindImageTexture(0, pressureTex[currentPressure], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-        glBindImageTexture(1, uVelocityTex[currentVel], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-        glBindImageTexture(2, uVelocityTex[1 - currentVel], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
-        glDispatchCompute(uGroupsX, uGroupsY, 1);
-        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
-        // Gradient subtract for v (512x513)
-        glUseProgram(gradientSubtractVProgram);
-        glUniform2i(glGetUniformLocation(gradientSubtractVProgram, "vSize"), V_WIDTH, V_HEIGHT);
-        glUniform2i(glGetUniformLocation(gradientSubtractVProgram, "pressSize"), SIM_WIDTH, SIM_HEIGHT);
-        glBindImageTexture(0, pressureTex[currentPressure], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-        glBindImageTexture(1, vVelocityTex[currentVel], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-        glBindImageTexture(2, vVelocityTex[1 - currentVel], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
-        glDispatchCompute(vGroupsX, vGroupsY, 1);
-        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
-        currentVel = 1 - currentVel;
-        glPopDebugGroup();
+        // Skip density advection in test mode; always compute stats
+        createDiagnosticsResources();
+        postDivergenceTex = acquireTransient("postDivergence", GL_R32F, SIM_WIDTH, SIM_HEIGHT, GL_NEAREST);
+        addDivergencePass(g, "Post-Divergence", vel, postDivergenceTex, "postDivergence", 0);
+        addStatsPasses(g);
+        runStats = 1;
+        previousDensityValid = 0;
+    } else {
+        // === NORMAL SIMULATION MODE ===
+        // Order: advect density, advect velocity, (forces injected via mouse), project
+        // This ensures displayed velocity is always divergence-free
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Normal Simulation");
+
+        // 0. Active tiles from the current velocity and dye
+        tiled = sparseTiles;
+        if (tiled) {
+            addTilePasses(g, vel, density);
+        }
 
-        // 6. Compute post-divergence
-        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Post-Divergence");
-        glUseProgram(divergenceProgram);
-        glBindImageTexture(0, uVelocityTex[currentVel], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-        glBindImageTexture(1, vVelocityTex[currentVel], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-        glBindImageTexture(2, postDivergenceTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
-        glDispatchCompute(groupsX, groupsY, 1);
-        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
-        glPopDebugGroup();
+        // 1. Advect density using projected velocity from previous frame
+        addFieldAdvection(g, ADVECT_FIELD_DENSITY, vel, density, densityTex[1 - density],
+                          densityNames[1 - density], tiled);
+        density = 1 - density;
+        previousDensityValid = 1;
+
+        // 2. Advect velocity with itself - u (513x512) and v (512x513), fused or split
+        addVelocityAdvection(g, vel, density, tiled);
+        vel = 1 - vel;
+
+        // 2b. Apply queued mouse splats (after advection, before projection)
+        int splatCells[4];
+        int splatted = numQueuedSplats > 0 && addForcePasses(g, vel, density, splatCells);
+
+        // Diagnostics: post-divergence feeds the histogram and the post-divergence view
+        runStats = diagnosticsDue();
+        simFrame++;
+        splatSpeedHistory[simFrame % SPLAT_SPEED_HISTORY] = splatted ? queuedSplatSpeed() : 0.0f;
+
+        // 3-5. Divergence, pressure solve (Red-Black SOR), gradient subtraction
+        vel = addProjectionPasses(g, vel, tiled, splatted ? splatCells : NULL,
+                                  runStats || displayMode == 2 || flowMetricsEnabled, displayMode == 4);
+
+        // Post-divergence measures the projected (global) velocity, so it stays full-grid
+        if (runStats || displayMode == 3) {
+            createDiagnosticsResources();
+            postDivergenceTex = acquireTransient("postDivergence", GL_R32F, SIM_WIDTH, SIM_HEIGHT, GL_NEAREST);
+            addDivergencePass(g, "Post-Divergence", vel, postDivergenceTex, "postDivergence", 0);
+        }
+        if (runStats) {
+            addStatsPasses(g);
+        }
+    }
 
-        // Compute stats
-        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Divergence Stats");
-        clearStats2D();
-        computeStats2D(divergenceTex, postDivergenceTex);
-        glPopDebugGroup();
+    // Health metrics of the projected state, every frame
+    if (flowMetricsEnabled) addFlowMetricsPasses(g, vel, density);
 
-        glPopDebugGroup(); // End Debug Test Mode
+    // Skipped tiles are only known to be zero while every frame runs tiled
+    if (!tiled) tileStateValid = 0;
 
-        // Skip density advection in test mode
-        return;
-    }
+    currentVel = vel;
+    currentDensity = density;
+    int tileCountRead = tiled && diagnosticsLevel != DIAGNOSTICS_OFF;
+    int solveCountRead = activeSetSolve && diagnosticsLevel != DIAGNOSTICS_OFF && pressureIterations > 0;
+    addFrameExports(g, runStats, flowMetricsEnabled, tileCountRead, solveCountRead);
 
-    // === NORMAL SIMULATION MODE ===
-    // Order: advect density, advect velocity, (forces injected via mouse), project
-    // This ensures displayed velocity is always divergence-free
-
-    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Normal Simulation");
-
-    // 1. Advect density using projected velocity from previous frame
-    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Advect Density");
-    glUseProgram(advectDensityProgram);
-    glUniform1f(glGetUniformLocation(advectDensityProgram, "dt"), dt);
-    glUniform2f(glGetUniformLocation(advectDensityProgram, "texelSize"), 1.0f / SIM_WIDTH, 1.0f / SIM_HEIGHT);
-    glUniform1f(glGetUniformLocation(advectDensityProgram, "dissipation"), 0.999f);
-    glUniform1i(glGetUniformLocation(advectDensityProgram, "densityIn"), 0);
-    // Bind velocity as images (for imageLoad at discrete positions)
-    glBindImageTexture(0, uVelocityTex[currentVel], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-    glBindImageTexture(1, vVelocityTex[currentVel], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-    glBindImageTexture(2, densityTex[1 - currentDensity], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-    // Bind density input as sampler (for bilinear interpolation during backtracing)
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, densityTex[currentDensity]);
-    glDispatchCompute(groupsX, groupsY, 1);
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
-    currentDensity = 1 - currentDensity;
+    fgCompile(g);
+    fgExecute(g);
+    if (flowMetricsEnabled) queueFlowMetricsReadback();
+    queueCounterReadback(tileCountRead, solveCountRead);
     glPopDebugGroup();
 
-    // 2. Advect velocity with itself - split into u and v passes
-    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Advect Velocity");
-
-    // Advect u (513x512)
-    glUseProgram(advectUProgram);
-    glUniform1f(glGetUniformLocation(advectUProgram, "dt"), dt);
-    glUniform1f(glGetUniformLocation(advectUProgram, "dissipation"), 1.0f);
-    glUniform2i(glGetUniformLocation(advectUProgram, "uSize"), U_WIDTH, U_HEIGHT);
-    glUniform2i(glGetUniformLocation(advectUProgram, "vSize"), V_WIDTH, V_HEIGHT);
-    glUniform1i(glGetUniformLocation(advectUProgram, "uVelocitySampler"), 0);
-    glUniform1i(glGetUniformLocation(advectUProgram, "vVelocitySampler"), 1);
-    glBindImageTexture(0, uVelocityTex[1 - currentVel], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, uVelocityTex[currentVel]);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, vVelocityTex[currentVel]);
-    glDispatchCompute(uGroupsX, uGroupsY, 1);
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
-
-    // Advect v (512x513)
-    glUseProgram(advectVProgram);
-    glUniform1f(glGetUniformLocation(advectVProgram, "dt"), dt);
-    glUniform1f(glGetUniformLocation(advectVProgram, "dissipation"), 1.0f);
-    glUniform2i(glGetUniformLocation(advectVProgram, "uSize"), U_WIDTH, U_HEIGHT);
-    glUniform2i(glGetUniformLocation(advectVProgram, "vSize"), V_WIDTH, V_HEIGHT);
-    glUniform1i(glGetUniformLocation(advectVProgram, "uVelocitySampler"), 0);
-    glUniform1i(glGetUniformLocation(advectVProgram, "vVelocitySampler"), 1);
-    glBindImageTexture(0, vVelocityTex[1 - currentVel], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, uVelocityTex[currentVel]);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, vVelocityTex[currentVel]);
-    glDispatchCompute(vGroupsX, vGroupsY, 1);
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
-
-    currentVel = 1 - currentVel;
-    glPopDebugGroup();
+    // Queued input has been applied (debug test mode ignores it)
+    numQueuedSplats = 0;
 
-    // 2b. Apply pending forces (after advection, before projection)
-    if (hasPendingForce && !debugTestMode) {
-        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Add Force");
-        addForce(pendingForceX, pendingForceY, pendingForceDX, pendingForceDY);
-        hasPendingForce = 0;
-        glPopDebugGroup();
+    if (printFrameGraphPending) {
+        fgPrint(g);
+        printFrameGraphPending = 0;
     }
+}
 
-    // 3. Compute pre-projection divergence
-    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Pre-Divergence");
-    glUseProgram(divergenceProgram);
-    glBindImageTexture(0, uVelocityTex[currentVel], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-    glBindImageTexture(1, vVelocityTex[currentVel], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-    glBindImageTexture(2, divergenceTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
-    glDispatchCompute(groupsX, groupsY, 1);
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-    glPopDebugGroup();
-
-    // 4. Pressure solve (Red-Black SOR)
-    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Pressure Solve");
-    clearTextureR(pressureTex[currentPressure]);
-    glUseProgram(pressureProgram);
-    glUniform1f(glGetUniformLocation(pressureProgram, "omega"), pressureOmega);
-    glBindImageTexture(0, pressureTex[currentPressure], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
-    glBindImageTexture(1, divergenceTex, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+// Bound on max |u| for the next step: the newest measured face maximum plus
+// whatever splats were applied since (or are queued). Without metrics, or when
+// they are further behind than the history, assume the clamp.
+float estimateMaxSpeed(void) {
+    unsigned int unseen = simFrame - flowMetricsFrame;
+    if (!flowMetricsEnabled || !flowMetricsValid || unseen >= SPLAT_SPEED_HISTORY) return MAX_VELOCITY;
 
-    for (int i = 0; i < pressureIterations; i++) {
-        glUniform1i(glGetUniformLocation(pressureProgram, "redPass"), 1);
-        glDispatchCompute(groupsX, groupsY, 1);
-        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-        glUniform1i(glGetUniformLocation(pressureProgram, "redPass"), 0);
-        glDispatchCompute(groupsX, groupsY, 1);
-        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    float speed = fmaxf(flowMetrics.maxU, flowMetrics.maxV) + queuedSplatSpeed();
+    for (unsigned int k = 1; k <= unseen; k++) {
+        speed += splatSpeedHistory[(flowMetricsFrame + k) % SPLAT_SPEED_HISTORY];
     }
-    glPopDebugGroup();
+    return fminf(speed, MAX_VELOCITY);
+}
 
-    // 5. Gradient subtraction (projection) - split into u and v passes
-    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Gradient Subtract");
-
-    // Gradient subtract for u (513x512)
-    glUseProgram(gradientSubtractUProgram);
-    glUniform2i(glGetUniformLocation(gradientSubtractUProgram, "uSize"), U_WIDTH, U_HEIGHT);
-    glUniform2i(glGetUniformLocation(gradientSubtractUProgram, "pressSize"), SIM_WIDTH, SIM_HEIGHT);
-    glBindImageTexture(0, pressureTex[currentPressure], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-    glBindImageTexture(1, uVelocityTex[currentVel], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-    glBindImageTexture(2, uVelocityTex[1 - currentVel], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
-    glDispatchCompute(uGroupsX, uGroupsY, 1);
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
-    // Gradient subtract for v (512x513)
-    glUseProgram(gradientSubtractVProgram);
-    glUniform2i(glGetUniformLocation(gradientSubtractVProgram, "vSize"), V_WIDTH, V_HEIGHT);
-    glUniform2i(glGetUniformLocation(gradientSubtractVProgram, "pressSize"), SIM_WIDTH, SIM_HEIGHT);
-    glBindImageTexture(0, pressureTex[currentPressure], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-    glBindImageTexture(1, vVelocityTex[currentVel], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-    glBindImageTexture(2, vVelocityTex[1 - currentVel], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
-    glDispatchCompute(vGroupsX, vGroupsY, 1);
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
-    currentVel = 1 - currentVel;
-    glPopDebugGroup();
+// Runs the steps due this frame. Variable mode steps by the frame delta; fixed
+// mode banks the delta and steps by 1/simStepRate, so the simulation cost per
+// second follows simStepRate rather than the display rate. Whatever is left
+// over sets densityBlend for render(). CFL mode splits the frame delta into as
+// few equal steps as keep the estimated max |u| * dt under targetCfl.
+void advanceSimulation(float frameDt) {
+    // Clamp dt to avoid instability (and a burst of substeps after a stall)
+    if (frameDt > 0.1f) frameDt = 0.1f;
+    densityBlend = 1.0f;
+
+    if (timestepMode == TIMESTEP_FRAME) {
+        simulate(frameDt);
+        substepsLastFrame = 1;
+        return;
+    }
 
-    // Compute post-divergence for visualization
-    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Post-Divergence");
-    glUseProgram(divergenceProgram);
-    glBindImageTexture(0, uVelocityTex[currentVel], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-    glBindImageTexture(1, vVelocityTex[currentVel], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-    glBindImageTexture(2, postDivergenceTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
-    glDispatchCompute(groupsX, groupsY, 1);
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
-    glPopDebugGroup();
+    if (timestepMode == TIMESTEP_CFL) {
+        cflSpeedEstimate = estimateMaxSpeed();
+        int steps = (int)ceilf(cflSpeedEstimate * frameDt / targetCfl);
+        if (steps < 1) steps = 1;
+        if (steps > maxSubsteps) steps = maxSubsteps;
+        for (int k = 0; k < steps; k++) simulate(frameDt / steps);
+        substepsLastFrame = steps;
+        return;
+    }
 
-    // Compute stats
-    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Divergence Stats");
-    clearStats2D();
-    computeStats2D(divergenceTex, postDivergenceTex);
-    glPopDebugGroup();
+    double step = 1.0 / simStepRate;
+    stepAccumulator += frameDt;
+    stepAccumulatorTime = glfwGetTime();
+    int steps = 0;
+    while (stepAccumulator >= step && steps < maxSubsteps) {
+        simulate((float)step);
+        stepAccumulator -= step;
+        steps++;
+    }
+    // Too slow to keep up: drop the backlog rather than fall further behind
+    if (stepAccumulator >= step) {
+        int behind = (int)(stepAccumulator / step);
+        droppedSteps += behind;
+        stepAccumulator -= behind * step;
+    }
+    substepsLastFrame = steps;
 
-    glPopDebugGroup(); // End Normal Simulation
+    // The screen shows the state one step back plus the leftover fraction
+    if (interpolateRender && previousDensityValid) densityBlend = (float)(stepAccumulator / step);
 }
 
-void addForce(float x, float y, float dx, float dy) {
-    // Ignore mouse input in debug test mode
-    if (debugTestMode) return;
-
-    // Dispatch sizes for different grid dimensions
-    int groupsX = (SIM_WIDTH + 15) / 16;
-    int groupsY = (SIM_HEIGHT + 15) / 16;
-    int uGroupsX = (U_WIDTH + 15) / 16;
-    int uGroupsY = (U_HEIGHT + 15) / 16;
-    int vGroupsX = (V_WIDTH + 15) / 16;
-    int vGroupsY = (V_HEIGHT + 15) / 16;
+// HUD values from the simulation globals (see SimStatus)
+void captureSimStatus(SimStatus* s) {
+    s->simFrame = simFrame;
+    s->displayMode = displayMode;
+    s->pressureIterations = pressureIterations;
+    s->pressureOmega = pressureOmega;
+    s->diagnosticsLevel = diagnosticsLevel;
+    s->diagnosticsInterval = diagnosticsInterval;
+    s->hostUploadBytes = hostUploadBytes;
+    s->sparseTiles = sparseTiles;
+    s->activeTileCount = activeTileCount;
+    s->activeSetSolve = activeSetSolve;
+    s->solveSweptFraction = solveSweptFraction;
+    s->debugTestMode = debugTestMode;
+    s->advectionScheme = advectionScheme;
+    s->velocityBacktraceOrder = velocityBacktraceOrder;
+    s->densityBacktraceOrder = densityBacktraceOrder;
+    s->fusedVelocityAdvection = fusedVelocityAdvection;
+    s->advectHalo = advectHalo;
+    s->timestepMode = timestepMode;
+    s->stepDt = frameParams.dt;
+    s->stepBlend = densityBlend;
+    s->stepBlendTime = stepAccumulatorTime;
+    s->simStepRate = simStepRate;
+    s->targetCfl = targetCfl;
+    s->cflSpeedEstimate = cflSpeedEstimate;
+    s->substeps = substepsLastFrame;
+    s->droppedSteps = droppedSteps;
+    s->showConvergence = showConvergence;
+    s->showHistory = showHistory;
+    s->showHotSpots = showHotSpots;
+    s->statsHistoryWritten = statsHistoryWritten;
+    s->flowMetricsShown = flowMetricsEnabled && flowMetricsValid;
+    s->flowMetrics = flowMetrics;
+    s->flowMetricsFrame = flowMetricsFrame;
+    s->flowMetricsDt = flowMetricsDt;
+    s->simStepsPerSecond = simThreadRunning ? simStepsPerSecond : 0.0f;
+    s->inputDropped = (unsigned int)atomicLoad(&inputQueue.dropped);
+}
 
-    // Convert screen-space delta to grid-space velocity (grid cells per second)
-    // dx/dy are in normalized screen coords per frame, scale to reasonable velocity
-    float forceScale = 100.0f * SIM_WIDTH;  // Scale factor for force (reduced from 300)
-    float fx = dx * forceScale;
-    float fy = dy * forceScale;
+// Single-threaded frame: the live simulation objects, valid until the next simulate()
+void captureLiveFrame(PresentSlot* frame) {
+    frame->density = densityTex[currentDensity];
+    frame->previousDensity = densityTex[1 - currentDensity];
+    frame->densityBlend = densityBlend;
+    frame->u = uVelocityTex[currentVel];
+    frame->v = vVelocityTex[currentVel];
+    frame->field = displayMode == 3 ? postDivergenceTex : displayMode == 4 ? pressureTex : divergenceTex;
+    frame->stats = statsBuffer;
+    frame->statsSummary = statsSummaryBuffer;
+    frame->statsHistory = statsHistoryBuffer;
+    frame->hasStats = statsBuffer != 0;
+    frame->hasHistory = statsHistoryBuffer != 0;
+    frame->published = 1;
+    captureSimStatus(&frame->status);
+}
 
-    // Generate color based on direction
-    float angle = atan2f(fy, fx);
-    float r = 0.5f + 0.5f * cosf(angle);
-    float g = 0.5f + 0.5f * cosf(angle + 2.094f);  // 120 degrees
-    float b = 0.5f + 0.5f * cosf(angle + 4.189f);  // 240 degrees
-
-    // Add force to u-velocity (513x512)
-    glUseProgram(addForceUProgram);
-    glUniform2f(glGetUniformLocation(addForceUProgram, "point"), x, y);
-    glUniform1f(glGetUniformLocation(addForceUProgram, "forceX"), fx);
-    glUniform1f(glGetUniformLocation(addForceUProgram, "radius"), 0.02f);
-    glUniform2i(glGetUniformLocation(addForceUProgram, "uSize"), U_WIDTH, U_HEIGHT);
-    glBindImageTexture(0, uVelocityTex[currentVel], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
-    glDispatchCompute(uGroupsX, uGroupsY, 1);
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
-    // Add force to v-velocity (512x513)
-    glUseProgram(addForceVProgram);
-    glUniform2f(glGetUniformLocation(addForceVProgram, "point"), x, y);
-    glUniform1f(glGetUniformLocation(addForceVProgram, "forceY"), fy);
-    glUniform1f(glGetUniformLocation(addForceVProgram, "radius"), 0.02f);
-    glUniform2i(glGetUniformLocation(addForceVProgram, "vSize"), V_WIDTH, V_HEIGHT);
-    glBindImageTexture(0, vVelocityTex[currentVel], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
-    glDispatchCompute(vGroupsX, vGroupsY, 1);
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
-    // Add dye to density (512x512)
-    glUseProgram(addForceDensityProgram);
-    glUniform2f(glGetUniformLocation(addForceDensityProgram, "point"), x, y);
-    glUniform1f(glGetUniformLocation(addForceDensityProgram, "radius"), 0.02f);
-    glUniform3f(glGetUniformLocation(addForceDensityProgram, "dyeColor"), r, g, b);
-    glUniform2i(glGetUniformLocation(addForceDensityProgram, "densitySize"), SIM_WIDTH, SIM_HEIGHT);
-    glBindImageTexture(0, densityTex[currentDensity], 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-    glDispatchCompute(groupsX, groupsY, 1);
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-}
-
-void render(void) {
+void render(const PresentSlot* frame) {
     glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Render");
     glClear(GL_COLOR_BUFFER_BIT);
+    if (!frame->published) {
+        glPopDebugGroup();
+        return;
+    }
 
     glUseProgram(renderProgram);
+    int mode = frame->status.displayMode;
 
     // Bind density texture to unit 0
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, densityTex[currentDensity]);
-    glUniform1i(glGetUniformLocation(renderProgram, "densityTex"), 0);
+    glBindTexture(GL_TEXTURE_2D, frame->density);
 
     // Bind divergence/pressure texture to unit 1
     glActiveTexture(GL_TEXTURE1);
-    if (displayMode == 2) {
-        glBindTexture(GL_TEXTURE_2D, divergenceTex);  // Pre-projection
-    } else if (displayMode == 3) {
-        glBindTexture(GL_TEXTURE_2D, postDivergenceTex);  // Post-projection
-    } else if (displayMode == 4) {
-        glBindTexture(GL_TEXTURE_2D, pressureTex[currentPressure]);  // Pressure
-    } else {
-        glBindTexture(GL_TEXTURE_2D, divergenceTex);  // Default
-    }
-    glUniform1i(glGetUniformLocation(renderProgram, "divergenceTex"), 1);
+    glBindTexture(GL_TEXTURE_2D, frame->field);
 
     // Bind velocity textures to units 2 and 3 for velocity visualization
     glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, uVelocityTex[currentVel]);
-    glUniform1i(glGetUniformLocation(renderProgram, "uVelocityTex"), 2);
+    glBindTexture(GL_TEXTURE_2D, frame->u);
     glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, vVelocityTex[currentVel]);
-    glUniform1i(glGetUniformLocation(renderProgram, "vVelocityTex"), 3);
+    glBindTexture(GL_TEXTURE_2D, frame->v);
+
+    // The dye state before the last step, for the fixed-step blend
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_2D, frame->previousDensity);
+    glUniform1f(renderDensityBlendLoc, frame->previousDensity ? frame->densityBlend : 1.0f);
 
     // Set display mode (shader uses 2 for pre/post divergence, 3 for pressure)
-    int shaderMode = displayMode;
-    if (displayMode == 3) shaderMode = 2;  // post-divergence uses same shader as pre
-    if (displayMode == 4) shaderMode = 3;  // pressure mode
-    glUniform1i(glGetUniformLocation(renderProgram, "displayMode"), shaderMode);
+    int shaderMode = mode;
+    if (mode == 3) shaderMode = 2;  // post-divergence uses same shader as pre
+    if (mode == 4) shaderMode = 3;  // pressure mode
+    glUniform1i(renderDisplayModeLoc, shaderMode);
 
     glBindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
     glPopDebugGroup();
 }
 
+// Convergence panel (worst bins and the transition heatmap), drawn straight
+// from the stats SSBOs by stats_overlay.frag: no readback. The headers are HUD
+// text; panel offsets are constants in the shader.
+#define STATS_PANEL_X 10
+#define STATS_PANEL_Y 290
+#define STATS_PANEL_WIDTH 384
+#define STATS_PANEL_HEIGHT 446
+
+void renderStatsOverlay(const PresentSlot* frame) {
+    if (!frame->hasStats) return;
+    hudText("Pre-projection (worst bins):", STATS_PANEL_X, STATS_PANEL_Y - 20, 2.0f, 1.0f, 0.8f, 0.5f);
+    hudText("Post-projection (worst bins):", STATS_PANEL_X, STATS_PANEL_Y + 80, 2.0f, 0.5f, 1.0f, 0.5f);
+    hudText("Transitions (rows=post, cols=pre):", STATS_PANEL_X, STATS_PANEL_Y + 170, 2.0f, 0.8f, 0.8f, 0.8f);
+
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Stats Overlay");
+    glUseProgram(statsOverlayProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, fontTexture);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, frame->stats);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STATS_SUMMARY_BINDING, frame->statsSummary);
+    glBindVertexArray(quadVAO);  // No attributes used; corners come from gl_VertexID
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glPopDebugGroup();
+}
+
+// Convergence timeline from the history ring by stats_history.frag, at the
+// bottom of the window: pre rows (3 px per bin), then post rows from y = 130
+#define HISTORY_PANEL_X 10
+#define HISTORY_PANEL_Y (WINDOW_HEIGHT - 236)
+#define HISTORY_PANEL_WIDTH 1024
+#define HISTORY_PANEL_HEIGHT 226
+
+void renderStatsHistory(const PresentSlot* frame) {
+    if (!frame->hasHistory) return;
+    char buf[96];
+    unsigned int written = frame->status.statsHistoryWritten;
+    unsigned int shown = written < HISTORY_FRAMES ? written : HISTORY_FRAMES;
+    snprintf(buf, sizeof(buf), "Pre-projection history (%u entries, newest right):", shown);
+    hudText(buf, HISTORY_PANEL_X, HISTORY_PANEL_Y - 20, 2.0f, 1.0f, 0.8f, 0.5f);
+    hudText("Post-projection history:", HISTORY_PANEL_X, HISTORY_PANEL_Y + 111, 2.0f, 0.5f, 1.0f, 0.5f);
+
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Stats History");
+    glUseProgram(statsHistoryProgram);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STATS_HISTORY_BINDING, frame->statsHistory);
+    glBindVertexArray(quadVAO);  // No attributes used; corners come from gl_VertexID
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glPopDebugGroup();
+}
+
+// Writes the history ring to STATS_HISTORY_FILE as CSV, oldest entry first:
+// the CPU metadata, then the pre and post marginals by exponent. One readback.
+void dumpStatsHistory(void) {
+    if (!statsHistoryBuffer || statsHistoryWritten == 0) {
+        printf("Convergence history: empty\n");
+        return;
+    }
+
+    GLuint* data = malloc(STATS_HISTORY_BYTES);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsHistoryBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, STATS_HISTORY_BYTES, data);
+    const GLuint* pre = data + 1;
+    const GLuint* post = pre + HISTORY_FRAMES * 36;
+    if (data[0] != statsHistoryWritten) {
+        fprintf(stderr, "Convergence history: GPU has %u entries, CPU %u\n", data[0], statsHistoryWritten);
+    }
+
+    FILE* f = fopen(STATS_HISTORY_FILE, "w");
+    if (!f) {
+        fprintf(stderr, "Convergence history: cannot write %s\n", STATS_HISTORY_FILE);
+        free(data);
+        return;
+    }
+    fprintf(f, "frame,time,dt,iterations,omega,sparse_tiles,active_set,debug_test");
+    for (int b = 0; b < 36; b++) fprintf(f, ",pre_%d", b - 24);
+    for (int b = 0; b < 32; b++) fprintf(f, ",post_%d", b - 24);
+    fprintf(f, "\n");
+
+    unsigned int first = statsHistoryWritten > HISTORY_FRAMES ? statsHistoryWritten - HISTORY_FRAMES : 0;
+    for (unsigned int k = first; k < statsHistoryWritten; k++) {
+        unsigned int slot = k % HISTORY_FRAMES;
+        const StatsHistoryEntry* e = &statsHistoryEntries[slot];
+        fprintf(f, "%u,%.4f,%.6f,%d,%.3f,%d,%d,%d", e->simFrame, e->time, e->dt, e->iterations,
+                e->omega, e->sparseTiles, e->activeSetSolve, e->debugTestMode);
+        for (int b = 0; b < 36; b++) fprintf(f, ",%u", pre[slot * 36 + b]);
+        for (int b = 0; b < 32; b++) fprintf(f, ",%u", post[slot * 32 + b]);
+        fprintf(f, "\n");
+    }
+    fclose(f);
+    printf("Convergence history: wrote %u entries (frames %u-%u) to %s\n", statsHistoryWritten - first,
+           statsHistoryEntries[first % HISTORY_FRAMES].simFrame,
+           statsHistoryEntries[(statsHistoryWritten - 1) % HISTORY_FRAMES].simFrame, STATS_HISTORY_FILE);
+    free(data);
+}
+
+// Worst-divergence cells from the metrics readback: a numbered list at (x, y)
+// and a marker on each cell, the rank for post-projection, '+' for pre
+void renderHotSpots(const FlowMetrics* fm, float x, float y) {
+    static const char* titles[2] = {"Worst |div| pre:", "Worst |div| post:"};
+    static const float colors[2][3] = {{1.0f, 0.8f, 0.5f}, {1.0f, 0.3f, 0.3f}};
+    char buf[64];
+    for (int side = 1; side >= 0; side--) {
+        const float* c = colors[side];
+        hudText(titles[side], x, y, 2.0f, c[0], c[1], c[2]);
+        y += 20;
+        for (int k = 0; k < HOT_SPOTS; k++) {
+            GLuint cell = fm->hotSpotCells[side][k];
+            if (cell == NO_HOT_SPOT) break;
+            int cx = (int)(cell & 0xFFFF);
+            int cy = (int)(cell >> 16);
+            snprintf(buf, sizeof(buf), "%d (%d, %d): %.2e", k + 1, cx, cy, fm->hotSpotValues[side][k]);
+            hudText(buf, x, y, 2.0f, c[0], c[1], c[2]);
+            y += 20;
+
+            // Cell centre on screen (render() flips y), marker glyph centred on it
+            float sx = (cx + 0.5f) * WINDOW_WIDTH / SIM_WIDTH;
+            float sy = (1.0f - (cy + 0.5f) / SIM_HEIGHT) * WINDOW_HEIGHT;
+            char marker[2] = {side ? (char)('1' + k) : '+', '\0'};
+            hudText(marker, sx - 8.0f, sy - 8.0f, 2.0f, c[0], c[1], c[2]);
+        }
+        y += 10;
+    }
+}
+
 void setupImpulseTest(void) {
     // Clear all textures first
     clearTextureU(uVelocityTex[0]);
@@ -1030,29 +3655,23 @@ void setupImpulseTest(void) {
     clearTextureV(vVelocityTex[1]);
     clearTextureRGBA(densityTex[0]);
     clearTextureRGBA(densityTex[1]);
-    clearTextureR(pressureTex[0]);
-    clearTextureR(pressureTex[1]);
     currentVel = 0;
-    currentPressure = 0;
     currentDensity = 0;
 
-    // Set a single point impulse at center
+    // Set a single point impulse at center, u velocity pointing right
     int cx = SIM_WIDTH / 2;
     int cy = SIM_HEIGHT / 2;
-    float uImpulse = 1.0f;  // u velocity pointing right
-    float vImpulse = 0.0f;  // v velocity
-
-    glBindTexture(GL_TEXTURE_2D, uVelocityTex[currentVel]);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, cx, cy, 1, 1, GL_RED, GL_FLOAT, &uImpulse);
-    glBindTexture(GL_TEXTURE_2D, vVelocityTex[currentVel]);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, cx, cy, 1, 1, GL_RED, GL_FLOAT, &vImpulse);
+    int impulse[4] = {cx, cy, cx + 1, cy + 1};
+    fillTexture(&fillR32FPipeline, uVelocityTex[currentVel], U_WIDTH, U_HEIGHT, impulse, 1.0f);
 }
 
 // Returns: largest non-zero bin index (0-31), and count in that bin via pointer
 int evaluateConvergence(int* worstBinCount) {
-    DivergenceStats2D stats;
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
-    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(DivergenceStats2D), &stats);
+    DivergenceStats2D stats = {{0}};
+    if (statsBuffer) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(DivergenceStats2D), &stats);
+    }
 
     // Find the largest (worst) post-divergence bin with data
     // Post bins are rows, we want the highest row index with any count
@@ -1074,7 +3693,7 @@ int evaluateConvergence(int* worstBinCount) {
 }
 
 void testOmega(float omega, int* worstBin, int* worstCount) {
-    pressureOmega = omega;
+    setPressureOmega(omega);
 
     // Setup fresh impulse
     setupImpulseTest();
@@ -1087,6 +3706,10 @@ void testOmega(float omega, int* worstBin, int* worstCount) {
 }
 
 void runOmegaSearch(float omegaMin, float omegaMax, int numBins) {
+    // Every test step must produce a histogram
+    int savedLevel = diagnosticsLevel;
+    diagnosticsLevel = DIAGNOSTICS_FULL;
+
     printf("\nSearching omega in [%.4f, %.4f] with %d samples, %d iterations\n",
            omegaMin, omegaMax, numBins, pressureIterations);
     printf("%-10s %-12s %-12s\n", "Omega", "WorstBin", "Count");
@@ -1115,6 +3738,386 @@ void runOmegaSearch(float omegaMin, float omegaMax, int numBins) {
 
     printf("--------------------------------------\n");
     printf("Best: omega=%.4f, worst_bin=%d, count=%d\n", bestOmega, bestWorstBin - 24, bestWorstCount);
+
+    diagnosticsLevel = savedLevel;
+    updateDiagnosticsResources();
+}
+
+// Overlay text and panels for one presented frame: queued here, drawn by
+// hudFlush() in one call. Reads the frame's SimStatus, never the live globals.
+void renderHud(const PresentSlot* frame, float fps) {
+    if (!frame->published) return;
+    const SimStatus* s = &frame->status;
+    char buf[64];
+    snprintf(buf, sizeof(buf), "FPS: %.1f", fps);
+    hudText(buf, 10, 10, 2.0f, 1.0f, 1.0f, 1.0f);
+
+    snprintf(buf, sizeof(buf), "Iterations: %d", s->pressureIterations);
+    hudText(buf, 10, 30, 2.0f, 1.0f, 1.0f, 1.0f);
+
+    snprintf(buf, sizeof(buf), "Omega: %.3f", s->pressureOmega);
+    hudText(buf, 10, 50, 2.0f, 1.0f, 1.0f, 1.0f);
+
+    snprintf(buf, sizeof(buf), "Grid: %dx%d", SIM_WIDTH, SIM_HEIGHT);
+    hudText(buf, 10, 70, 2.0f, 1.0f, 1.0f, 1.0f);
+
+    const char* modeNames[] = {"DENSITY", "VELOCITY", "PRE-DIVERGENCE", "POST-DIVERGENCE", "PRESSURE"};
+    snprintf(buf, sizeof(buf), "View: %s", modeNames[s->displayMode]);
+    hudText(buf, 10, 90, 2.0f, 1.0f, 1.0f, 0.0f);
+
+    const char* levelNames[] = {"OFF", "SAMPLED", "FULL"};
+    if (s->diagnosticsLevel == DIAGNOSTICS_SAMPLED) {
+        snprintf(buf, sizeof(buf), "Diagnostics: %s (1/%d)", levelNames[s->diagnosticsLevel], s->diagnosticsInterval);
+    } else {
+        snprintf(buf, sizeof(buf), "Diagnostics: %s", levelNames[s->diagnosticsLevel]);
+    }
+    hudText(buf, 10, 110, 2.0f, 1.0f, 1.0f, 1.0f);
+
+    snprintf(buf, sizeof(buf), "Host->GPU: %zu B/frame", s->hostUploadBytes);
+    hudText(buf, 10, 130, 2.0f, 1.0f, 1.0f, 1.0f);
+
+    if (!s->sparseTiles) {
+        snprintf(buf, sizeof(buf), "Tiles: OFF");
+    } else if (s->activeTileCount >= 0) {
+        snprintf(buf, sizeof(buf), "Tiles: %d/%d active", s->activeTileCount, TILE_COUNT);
+    } else {
+        snprintf(buf, sizeof(buf), "Tiles: ON");
+    }
+    hudText(buf, 10, 150, 2.0f, 1.0f, 1.0f, 1.0f);
+
+    if (!s->activeSetSolve) {
+        snprintf(buf, sizeof(buf), "Solve: full sweeps");
+    } else if (s->solveSweptFraction >= 0.0f) {
+        snprintf(buf, sizeof(buf), "Solve: %.0f%% of tile sweeps", s->solveSweptFraction * 100.0f);
+    } else {
+        snprintf(buf, sizeof(buf), "Solve: active set");
+    }
+    hudText(buf, 10, 170, 2.0f, 1.0f, 1.0f, 1.0f);
+
+    if (s->timestepMode == TIMESTEP_FRAME) {
+        snprintf(buf, sizeof(buf), "Step: frame delta (%.1f ms)", s->stepDt * 1000.0f);
+    } else if (s->timestepMode == TIMESTEP_CFL) {
+        // Above the target only when maxSubsteps caps the split
+        snprintf(buf, sizeof(buf), "Step: CFL %.3g/%.3g, %d x %.2f ms", s->cflSpeedEstimate * s->stepDt,
+                 s->targetCfl, s->substeps, s->stepDt * 1000.0f);
+    } else {
+        snprintf(buf, sizeof(buf), "Step: %.0f Hz, %d/frame, %u dropped", s->simStepRate, s->substeps,
+                 s->droppedSteps);
+    }
+    hudText(buf, 10, 190, 2.0f, 1.0f, 1.0f, 1.0f);
+
+    const char* schemeNames[] = {"semi-Lagrangian", "MacCormack (limited)", "BFECC (limited)"};
+    const char* orderNames[] = {"", "Euler", "RK2", "RK3"};
+    char velocityKernel[32];
+    if (s->fusedVelocityAdvection) {
+        snprintf(velocityKernel, sizeof(velocityKernel), "fused, halo %d", s->advectHalo);
+    } else {
+        snprintf(velocityKernel, sizeof(velocityKernel), "split u/v");
+    }
+    snprintf(buf, sizeof(buf), "Advection: %s, trace %s/%s, %s", schemeNames[s->advectionScheme],
+             orderNames[s->velocityBacktraceOrder], orderNames[s->densityBacktraceOrder], velocityKernel);
+    hudText(buf, 10, 210, 2.0f, 1.0f, 1.0f, 1.0f);
+
+    if (s->debugTestMode) {
+        hudText("DEBUG TEST MODE (T to toggle)", 10, 230, 2.0f, 1.0f, 0.3f, 0.3f);
+    }
+
+    if (s->simStepsPerSecond > 0.0f) {
+        snprintf(buf, sizeof(buf), "Sim thread: %.0f steps/s", s->simStepsPerSecond);
+        if (s->inputDropped) snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), ", %u inputs lost", s->inputDropped);
+        hudText(buf, 10, 250, 2.0f, 1.0f, 1.0f, 1.0f);
+    }
+
+    // Flow metrics, right column; they arrive a frame or two after the step they measured
+    if (s->flowMetricsShown) {
+        const FlowMetrics* fm = &s->flowMetrics;
+        float x = WINDOW_WIDTH - 640;
+        snprintf(buf, sizeof(buf), "Flow metrics (%u frames old):", s->simFrame - s->flowMetricsFrame);
+        hudText(buf, x, 10, 2.0f, 0.6f, 0.8f, 1.0f);
+        snprintf(buf, sizeof(buf), "Energy: %.4g  Enstrophy: %.4g", fm->kineticEnergy, fm->enstrophy);
+        hudText(buf, x, 30, 2.0f, 1.0f, 1.0f, 1.0f);
+        snprintf(buf, sizeof(buf), "Max |u|: %.1f cells/s  CFL: %.2f", fm->maxSpeed,
+                 fmaxf(fm->maxU, fm->maxV) * s->flowMetricsDt);
+        hudText(buf, x, 50, 2.0f, 1.0f, 1.0f, 1.0f);
+        snprintf(buf, sizeof(buf), "Div L2 pre/post: %.2e / %.2e", fm->preDivergenceL2, fm->postDivergenceL2);
+        hudText(buf, x, 70, 2.0f, 1.0f, 1.0f, 1.0f);
+        snprintf(buf, sizeof(buf), "Div max pre/post: %.2e / %.2e", fm->preDivergenceMax, fm->postDivergenceMax);
+        hudText(buf, x, 90, 2.0f, 1.0f, 1.0f, 1.0f);
+        snprintf(buf, sizeof(buf), "Dye mass: %.4g", fm->dyeMass);
+        hudText(buf, x, 110, 2.0f, 1.0f, 1.0f, 1.0f);
+        if (s->showHotSpots) renderHotSpots(fm, x, 140);
+    }
+
+    if (s->showConvergence) renderStatsOverlay(frame);
+    if (s->showHistory) renderStatsHistory(frame);
+}
+
+// === Simulation thread ===
+// The window thread polls events, presents, and draws the newest published
+// frame; the simulation thread drains input, steps and publishes. They share
+// objects, not a context: everything crossing over goes through the input ring
+// or a present slot.
+
+// Window thread: queue one event for the simulation thread
+void pushInput(const InputEvent* event) {
+    InputQueue* q = &inputQueue;
+    long head = q->head;
+    // Indices run modulo twice the size, so a full ring differs from an empty one
+    if (((head - atomicLoad(&q->tail)) & (2 * INPUT_QUEUE_SIZE - 1)) == INPUT_QUEUE_SIZE) {
+        atomicStore(&q->dropped, q->dropped + 1);  // Only this thread writes it
+        return;
+    }
+    q->events[head & (INPUT_QUEUE_SIZE - 1)] = *event;
+    atomicStore(&q->head, (head + 1) & (2 * INPUT_QUEUE_SIZE - 1));
+}
+
+void handleKey(int key);
+
+// Simulation thread: apply everything queued since the last tick, in order
+void drainInput(void) {
+    InputQueue* q = &inputQueue;
+    long tail = q->tail;
+    long head = atomicLoad(&q->head);
+    while (tail != head) {
+        const InputEvent* event = &q->events[tail & (INPUT_QUEUE_SIZE - 1)];
+        if (event->type == INPUT_SPLAT) {
+            queueSplat(event->segment[0], event->segment[1], event->segment[2], event->segment[3]);
+        } else {
+            handleKey(event->key);
+        }
+        tail = (tail + 1) & (2 * INPUT_QUEUE_SIZE - 1);
+    }
+    atomicStore(&q->tail, tail);
+}
+
+static GLuint createPresentTexture(GLenum format, int width, int height, GLint filter) {
+    float borderColor[] = {0.0f, 0.0f, 0.0f, 0.0f};
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+    return tex;
+}
+
+// Textures of every slot, made before the thread starts. The overlay buffers
+// are made by the simulation thread the first time a slot carries them.
+void createPresentSlots(void) {
+    for (int i = 0; i < PRESENT_SLOTS; i++) {
+        PresentSlot* s = &presentSlots[i];
+        s->density = createPresentTexture(DENSITY_FORMAT, SIM_WIDTH, SIM_HEIGHT, GL_LINEAR);
+        s->densityBefore = createPresentTexture(DENSITY_FORMAT, SIM_WIDTH, SIM_HEIGHT, GL_LINEAR);
+        s->u = createPresentTexture(VELOCITY_FORMAT, U_WIDTH, U_HEIGHT, GL_LINEAR);
+        s->v = createPresentTexture(VELOCITY_FORMAT, V_WIDTH, V_HEIGHT, GL_LINEAR);
+        s->field = createPresentTexture(GL_R32F, SIM_WIDTH, SIM_HEIGHT, GL_NEAREST);
+    }
+}
+
+void destroyPresentSlots(void) {
+    for (int i = 0; i < PRESENT_SLOTS; i++) {
+        PresentSlot* s = &presentSlots[i];
+        glDeleteTextures(1, &s->density);
+        glDeleteTextures(1, &s->densityBefore);
+        glDeleteTextures(1, &s->u);
+        glDeleteTextures(1, &s->v);
+        glDeleteTextures(1, &s->field);
+        if (s->stats) glDeleteBuffers(1, &s->stats);
+        if (s->statsSummary) glDeleteBuffers(1, &s->statsSummary);
+        if (s->statsHistory) glDeleteBuffers(1, &s->statsHistory);
+        if (s->ready) glDeleteSync(s->ready);
+        if (s->released) glDeleteSync(s->released);
+        memset(s, 0, sizeof(*s));
+    }
+}
+
+static void copyPresentTexture(GLuint src, GLuint dst, int width, int height) {
+    glCopyImageSubData(src, GL_TEXTURE_2D, 0, 0, 0, 0, dst, GL_TEXTURE_2D, 0, 0, 0, 0, width, height, 1);
+}
+
+static void copyPresentBuffer(GLuint src, GLuint* dst, GLsizeiptr size) {
+    if (!*dst) {
+        glGenBuffers(1, dst);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, *dst);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_DYNAMIC_COPY);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, src);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, *dst);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+}
+
+// Simulation thread: copy what the current view and overlays draw into our
+// slot, fence it, and swap it in as the ready frame. The slot we get back may
+// still be read by the window thread's last draw, so the next publish into it
+// first waits (on the GPU) for that.
+void publishFrame(void) {
+    PresentSlot* s = &presentSlots[simPresentSlot];
+    if (s->released) {
+        glWaitSync(s->released, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(s->released);
+        s->released = 0;
+    }
+    if (s->ready) {
+        // Published earlier and never taken
+        glDeleteSync(s->ready);
+        s->ready = 0;
+    }
+
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Publish Frame");
+    if (displayMode == 0) {
+        copyPresentTexture(densityTex[currentDensity], s->density, SIM_WIDTH, SIM_HEIGHT);
+    } else if (displayMode == 1) {
+        copyPresentTexture(uVelocityTex[currentVel], s->u, U_WIDTH, U_HEIGHT);
+        copyPresentTexture(vVelocityTex[currentVel], s->v, V_WIDTH, V_HEIGHT);
+    } else {
+        GLuint field = displayMode == 2 ? divergenceTex : displayMode == 3 ? postDivergenceTex : pressureTex;
+        if (field) copyPresentTexture(field, s->field, SIM_WIDTH, SIM_HEIGHT);
+        GLint filter = displayMode == 4 ? GL_LINEAR : GL_NEAREST;  // As the transients
+        glBindTexture(GL_TEXTURE_2D, s->field);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    }
+    // The fixed-step blend needs the step before too; the window thread moves
+    // the blend on from stepBlend as time passes (acquirePresentFrame())
+    s->previousDensity = 0;
+    s->densityBlend = 1.0f;
+    if (displayMode == 0 && densityBlend < 1.0f) {
+        copyPresentTexture(densityTex[1 - currentDensity], s->densityBefore, SIM_WIDTH, SIM_HEIGHT);
+        s->previousDensity = s->densityBefore;
+        s->densityBlend = densityBlend;
+    }
+
+    s->hasStats = showConvergence && statsBuffer;
+    if (s->hasStats) {
+        copyPresentBuffer(statsBuffer, &s->stats, sizeof(DivergenceStats2D));
+        copyPresentBuffer(statsSummaryBuffer, &s->statsSummary, sizeof(StatsSummary));
+    }
+    s->hasHistory = showHistory && statsHistoryBuffer;
+    if (s->hasHistory) copyPresentBuffer(statsHistoryBuffer, &s->statsHistory, STATS_HISTORY_BYTES);
+    glPopDebugGroup();
+
+    captureSimStatus(&s->status);
+    s->published = 1;
+    s->ready = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();  // Another context may only wait on a fence that has been flushed
+    simPresentSlot = (int)(atomicExchange(&readyPresentSlot, simPresentSlot | PRESENT_NEW) & PRESENT_INDEX);
+}
+
+// Window thread: take the newest published frame if there is one (else keep
+// drawing the current one) and order our draws after its copies. A blended
+// frame advances its blend by the steps' worth of time since it was published,
+// as the accumulator would have; past the newest step it holds there.
+const PresentSlot* acquirePresentFrame(void) {
+    if (atomicLoad(&readyPresentSlot) & PRESENT_NEW) {
+        mainPresentSlot = (int)(atomicExchange(&readyPresentSlot, mainPresentSlot) & PRESENT_INDEX);
+        PresentSlot* s = &presentSlots[mainPresentSlot];
+        glWaitSync(s->ready, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(s->ready);
+        s->ready = 0;
+    }
+    PresentSlot* s = &presentSlots[mainPresentSlot];
+    if (s->previousDensity) {
+        double blend = s->status.stepBlend + (glfwGetTime() - s->status.stepBlendTime) * s->status.simStepRate;
+        s->densityBlend = blend < 1.0 ? (float)blend : 1.0f;
+    }
+    return s;
+}
+
+// Window thread: fence the draws that read the slot, for its next publish
+void releasePresentFrame(void) {
+    PresentSlot* s = &presentSlots[mainPresentSlot];
+    if (s->released) glDeleteSync(s->released);
+    s->released = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+}
+
+static void sleepSeconds(double seconds) {
+#ifdef _WIN32
+    Sleep((DWORD)(seconds * 1000.0));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+#endif
+}
+
+// One tick per 1/simStepRate: input, advanceSimulation() for the time since the
+// last tick, publish. The CPU runs at most one tick ahead of the GPU.
+void simThreadMain(void) {
+    glfwMakeContextCurrent(simWindow);
+    // Objects are shared, binding points are not: redo the ones made at startup
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_PARAMS_BINDING, frameParamsBuffer);
+    GLsync tickDone = 0;
+    double last = glfwGetTime();
+    double rateStart = last;
+    int rateSteps = 0;
+
+    while (!atomicLoad(&simThreadStop)) {
+        drainInput();
+        double now = glfwGetTime();
+        advanceSimulation((float)(now - last));
+        last = now;
+        publishFrame();
+
+        if (tickDone) {
+            while (glClientWaitSync(tickDone, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000) == GL_TIMEOUT_EXPIRED) {}
+            glDeleteSync(tickDone);
+        }
+        tickDone = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        rateSteps += substepsLastFrame;
+        if (now - rateStart >= 1.0) {
+            simStepsPerSecond = rateSteps / (float)(now - rateStart);
+            rateSteps = 0;
+            rateStart = now;
+        }
+        double wait = now + 1.0 / simStepRate - glfwGetTime();
+        if (wait > 0.0) sleepSeconds(wait);
+    }
+
+    if (tickDone) glDeleteSync(tickDone);
+    glFinish();
+    glfwMakeContextCurrent(NULL);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI simThreadEntry(LPVOID arg) {
+    (void)arg;
+    timeBeginPeriod(1);
+    simThreadMain();
+    timeEndPeriod(1);
+    return 0;
+}
+#else
+static void* simThreadEntry(void* arg) {
+    (void)arg;
+    simThreadMain();
+    return NULL;
+}
+#endif
+
+int startSimThread(void) {
+#ifdef _WIN32
+    simThread = CreateThread(NULL, 0, simThreadEntry, NULL, 0, NULL);
+    return simThread != NULL;
+#else
+    return pthread_create(&simThread, NULL, simThreadEntry, NULL) == 0;
+#endif
+}
+
+void stopSimThread(void) {
+    atomicStore(&simThreadStop, 1);
+#ifdef _WIN32
+    WaitForSingleObject(simThread, INFINITE);
+    CloseHandle(simThread);
+#else
+    pthread_join(simThread, NULL);
+#endif
+    simThreadRunning = 0;
 }
 
 void cursorPosCallback(GLFWwindow* window, double xpos, double ypos) {
@@ -1125,12 +4128,17 @@ void cursorPosCallback(GLFWwindow* window, double xpos, double ypos) {
         int width, height;
         glfwGetWindowSize(window, &width, &height);
 
-        // Store pending force to be applied in simulate() at the right time
-        pendingForceX = (float)xpos / width;
-        pendingForceY = 1.0f - (float)ypos / height;
-        pendingForceDX = (float)dx / width;
-        pendingForceDY = -(float)dy / height;
-        hasPendingForce = 1;
+        // Queue the segment from the previous position; simulate() applies the batch
+        if (dx != 0.0 || dy != 0.0) {
+            InputEvent event = {INPUT_SPLAT, 0,
+                                {(float)lastMouseX / width, 1.0f - (float)lastMouseY / height,
+                                 (float)xpos / width, 1.0f - (float)ypos / height}};
+            if (simThreadRunning) {
+                pushInput(&event);
+            } else {
+                queueSplat(event.segment[0], event.segment[1], event.segment[2], event.segment[3]);
+            }
+        }
     }
     lastMouseX = xpos;
     lastMouseY = ypos;
@@ -1143,10 +4151,22 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
 }
 
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
+    if (action != GLFW_PRESS) return;
+    if (key == GLFW_KEY_ESCAPE) {
         glfwSetWindowShouldClose(window, GLFW_TRUE);
+        return;
+    }
+    if (simThreadRunning) {
+        InputEvent event = {INPUT_KEY, key};
+        pushInput(&event);
+    } else {
+        handleKey(key);
     }
-    if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+}
+
+// Key presses other than ESC, on whichever thread runs the simulation
+void handleKey(int key) {
+    if (key == GLFW_KEY_R) {
         // Reset simulation
         clearTextureU(uVelocityTex[0]);
         clearTextureU(uVelocityTex[1]);
@@ -1154,23 +4174,113 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
         clearTextureV(vVelocityTex[1]);
         clearTextureRGBA(densityTex[0]);
         clearTextureRGBA(densityTex[1]);
-        clearTextureR(pressureTex[0]);
-        clearTextureR(pressureTex[1]);
     }
-    if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+    if (key == GLFW_KEY_V) {
         displayMode = (displayMode + 1) % 5;
         const char* modeNames[] = {"density", "velocity", "pre-divergence", "post-divergence", "pressure"};
         printf("Display mode: %s\n", modeNames[displayMode]);
+        updateDiagnosticsResources();
     }
-    if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+    if (key == GLFW_KEY_A) {
+        activeSetSolve = !activeSetSolve;
+        printf("Active-set pressure solve: %s\n", activeSetSolve ? "ON" : "OFF");
+    }
+    if (key == GLFW_KEY_C) {
         showConvergence = !showConvergence;
         printf("Convergence stats: %s\n", showConvergence ? "on" : "off");
+        if (showConvergence && diagnosticsLevel == DIAGNOSTICS_OFF) {
+            // The overlay needs histograms; switch diagnostics on
+            diagnosticsLevel = DIAGNOSTICS_FULL;
+            updateDiagnosticsResources();
+            printf("  -> Diagnostics: full\n");
+        }
         if (showConvergence) {
             printStats2DTable();
             debugPrintMarginals();
         }
     }
-    if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+    if (key == GLFW_KEY_H) {
+        showHistory = !showHistory;
+        printf("Convergence history: %s\n", showHistory ? "on" : "off");
+        if (showHistory && diagnosticsLevel == DIAGNOSTICS_OFF) {
+            // The timeline only grows while histograms run
+            diagnosticsLevel = DIAGNOSTICS_FULL;
+            updateDiagnosticsResources();
+            printf("  -> Diagnostics: full\n");
+        }
+    }
+    if (key == GLFW_KEY_W) {
+        dumpStatsHistory();
+    }
+    if (key == GLFW_KEY_F) {
+        flowMetricsEnabled = !flowMetricsEnabled;
+        printf("Flow metrics: %s\n", flowMetricsEnabled ? "ON" : "OFF");
+    }
+    if (key == GLFW_KEY_K) {
+        showHotSpots = !showHotSpots;
+        printf("Divergence hot spots: %s%s\n", showHotSpots ? "on" : "off",
+               showHotSpots && !flowMetricsEnabled ? " (flow metrics are off, F)" : "");
+    }
+    if (key == GLFW_KEY_D) {
+        diagnosticsLevel = (diagnosticsLevel + 1) % 3;
+        const char* levelNames[] = {"off", "sampled", "full"};
+        printf("Diagnostics: %s\n", levelNames[diagnosticsLevel]);
+        updateDiagnosticsResources();
+    }
+    if (key == GLFW_KEY_M) {
+        printMemoryReport();
+    }
+    if (key == GLFW_KEY_G) {
+        printFrameGraphPending = 1;  // Printed after the next simulate()
+    }
+    if (key == GLFW_KEY_S) {
+        sparseTiles = !sparseTiles;
+        printf("Sparse tiles: %s\n", sparseTiles ? "ON" : "OFF");
+    }
+    if (key == GLFW_KEY_P) {
+        timestepMode = (timestepMode + 1) % 3;
+        stepAccumulator = 0.0;
+        const char* modeNames[] = {"frame delta", "fixed", "CFL-adaptive"};
+        printf("Timestep: %s\n", modeNames[timestepMode]);
+        if (timestepMode == TIMESTEP_CFL && !flowMetricsEnabled) {
+            // The step size comes from the measured max velocity
+            flowMetricsEnabled = 1;
+            printf("  -> Flow metrics: ON\n");
+        }
+    }
+    if (key == GLFW_KEY_B) {
+        advectionScheme = (advectionScheme + 1) % 3;
+        const char* schemeNames[] = {"semi-Lagrangian", "MacCormack", "BFECC"};
+        printf("Advection: %s\n", schemeNames[advectionScheme]);
+    }
+    if (key == GLFW_KEY_O || key == GLFW_KEY_L) {
+        // O: velocity, L: dye
+        int* order = key == GLFW_KEY_O ? &velocityBacktraceOrder : &densityBacktraceOrder;
+        *order = *order % 3 + 1;
+        const char* orderNames[] = {"", "Euler", "midpoint (RK2)", "RK3"};
+        printf("%s backtrace: %s\n", key == GLFW_KEY_O ? "Velocity" : "Dye", orderNames[*order]);
+    }
+    if (key == GLFW_KEY_U) {
+        fusedVelocityAdvection = !fusedVelocityAdvection;
+        printf("Velocity advection: %s\n", fusedVelocityAdvection ? "fused (shared-memory tiles)" : "split u/v");
+    }
+    if (key == GLFW_KEY_I) {
+        interpolateRender = !interpolateRender;
+        printf("Render interpolation: %s\n", interpolateRender ? "ON" : "OFF");
+    }
+    if (key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET) {
+        // Step rate in fixed mode, target CFL number in CFL mode
+        float scale = key == GLFW_KEY_RIGHT_BRACKET ? 2.0f : 0.5f;
+        if (timestepMode == TIMESTEP_CFL) {
+            if (targetCfl * scale >= 0.125f && targetCfl * scale <= 8.0f) targetCfl *= scale;
+            printf("Target CFL: %.3g cells/step\n", targetCfl);
+        } else {
+            if (simStepRate * scale >= 15.0f && simStepRate * scale <= 960.0f) simStepRate *= scale;
+            printf("Simulation rate: %.0f steps/s (fixed timestep %s)\n", simStepRate,
+                   timestepMode == TIMESTEP_FIXED ? "on" : "off");
+        }
+    }
+    if (key == GLFW_KEY_T) {
         debugTestMode = !debugTestMode;
         printf("Debug test mode: %s\n", debugTestMode ? "ON (fixed impulse at center)" : "OFF (normal simulation)");
         if (debugTestMode) {
@@ -1181,10 +4291,16 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
             printf("  -> Press V to cycle: pre-divergence -> post-divergence -> pressure\n");
             printf("  -> Expected: pre-divergence shows point, post-divergence should be ~black\n");
         }
+        updateDiagnosticsResources();
     }
 }
 
-int main(void) {
+#ifndef FLUID_NO_MAIN
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--single-thread") == 0) simThreadEnabled = 0;
+    }
+
     if (!glfwInit()) {
         fprintf(stderr, "Failed to initialize GLFW\n");
         return -1;
@@ -1216,42 +4332,40 @@ int main(void) {
     glfwSetMouseButtonCallback(window, mouseButtonCallback);
     glfwSetKeyCallback(window, keyCallback);
 
-    // Load shaders - using split shaders for MAC grid
-    advectUProgram = createComputeShader("shaders/advect_u.comp");
-    advectVProgram = createComputeShader("shaders/advect_v.comp");
-    advectDensityProgram = createComputeShader("shaders/advect_density.comp");
-    divergenceProgram = createComputeShader("shaders/divergence.comp");
-    pressureProgram = createComputeShader("shaders/pressure.comp");
-    gradientSubtractUProgram = createComputeShader("shaders/gradient_subtract_u.comp");
-    gradientSubtractVProgram = createComputeShader("shaders/gradient_subtract_v.comp");
-    addForceUProgram = createComputeShader("shaders/add_force_u.comp");
-    addForceVProgram = createComputeShader("shaders/add_force_v.comp");
-    addForceDensityProgram = createComputeShader("shaders/add_force_density.comp");
-    divergenceStatsProgram = createComputeShader("shaders/divergence_stats.comp");
+    // Load shaders
+    int pipelinesOk = createPipelines();
     renderProgram = createRenderProgram("shaders/quad.vert", "shaders/render.frag");
     textProgram = createRenderProgram("shaders/text.vert", "shaders/text.frag");
+    statsOverlayProgram = createRenderProgram("shaders/stats_overlay.vert", "shaders/stats_overlay.frag");
+    statsHistoryProgram = createRenderProgram("shaders/stats_overlay.vert", "shaders/stats_history.frag");
 
-    if (!advectUProgram || !advectVProgram || !advectDensityProgram || !divergenceProgram ||
-        !pressureProgram || !gradientSubtractUProgram || !gradientSubtractVProgram ||
-        !addForceUProgram || !addForceVProgram || !addForceDensityProgram ||
-        !divergenceStatsProgram || !renderProgram || !textProgram) {
+    if (!pipelinesOk || !renderProgram || !textProgram || !statsOverlayProgram || !statsHistoryProgram) {
         fprintf(stderr, "Failed to load shaders\n");
         glfwTerminate();
         return -1;
     }
 
+    renderDisplayModeLoc = glGetUniformLocation(renderProgram, "displayMode");
+    renderDensityBlendLoc = glGetUniformLocation(renderProgram, "densityBlend");
+    glProgramUniform2f(statsOverlayProgram, glGetUniformLocation(statsOverlayProgram, "screenSize"),
+                       (float)WINDOW_WIDTH, (float)WINDOW_HEIGHT);
+    glProgramUniform4f(statsOverlayProgram, glGetUniformLocation(statsOverlayProgram, "panelRect"),
+                       STATS_PANEL_X, STATS_PANEL_Y, STATS_PANEL_WIDTH, STATS_PANEL_HEIGHT);
+    glProgramUniform2f(statsHistoryProgram, glGetUniformLocation(statsHistoryProgram, "screenSize"),
+                       (float)WINDOW_WIDTH, (float)WINDOW_HEIGHT);
+    glProgramUniform4f(statsHistoryProgram, glGetUniformLocation(statsHistoryProgram, "panelRect"),
+                       HISTORY_PANEL_X, HISTORY_PANEL_Y, HISTORY_PANEL_WIDTH, HISTORY_PANEL_HEIGHT);
+    glProgramUniform1ui(statsHistoryProgram, glGetUniformLocation(statsHistoryProgram, "cellCount"),
+                        SIM_WIDTH * SIM_HEIGHT);
+
     // Create resources
-    initClearData();
     createTextures();
+    createTileBuffers();
+    createFlowMetricsBuffers();
     createQuad();
     createFontTexture();
     createTextBuffers();
 
-    // Create stats buffer
-    glGenBuffers(1, &statsBuffer);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(DivergenceStats2D), NULL, GL_DYNAMIC_READ);
-
     // Initialize all simulation textures to zero
     clearTextureU(uVelocityTex[0]);
     clearTextureU(uVelocityTex[1]);
@@ -1259,23 +4373,49 @@ int main(void) {
     clearTextureV(vVelocityTex[1]);
     clearTextureRGBA(densityTex[0]);
     clearTextureRGBA(densityTex[1]);
-    clearTextureR(pressureTex[0]);
-    clearTextureR(pressureTex[1]);
 
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
     // Set solver parameters for interactive use
     pressureIterations = 512;
-    pressureOmega = 1.9f;
 
     printf("Controls:\n");
     printf("  Left mouse + drag: Add velocity and dye\n");
     printf("  R: Reset simulation\n");
     printf("  V: Cycle display mode (density/velocity/pre-div/post-div/pressure)\n");
     printf("  C: Toggle convergence stats\n");
+    printf("  H: Toggle convergence history timeline\n");
+    printf("  W: Write convergence history to %s\n", STATS_HISTORY_FILE);
+    printf("  D: Cycle diagnostics level (off/sampled/full)\n");
+    printf("  F: Toggle flow metrics (energy, CFL, divergence norms)\n");
+    printf("  K: Toggle worst-divergence cell markers\n");
+    printf("  G: Print frame graph schedule\n");
+    printf("  M: Print GPU/CPU memory report\n");
+    printf("  S: Toggle sparse active-tile simulation\n");
+    printf("  A: Toggle active-set pressure solve (skip converged tiles)\n");
+    printf("  B: Cycle advection scheme (semi-Lagrangian/MacCormack/BFECC)\n");
+    printf("  O/L: Cycle velocity/dye backtrace order (Euler/RK2/RK3)\n");
+    printf("  U: Toggle single-dispatch velocity advection (shared-memory tiles)\n");
+    printf("  P: Cycle timestep (frame delta/fixed/CFL-adaptive; [ ] halve/double rate or CFL, I: interpolation)\n");
     printf("  T: Toggle debug test mode (fixed impulse for pressure solver debugging)\n");
     printf("  ESC: Quit\n");
 
+    // Simulation thread, on a hidden window whose context shares our objects
+    if (simThreadEnabled) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        simWindow = glfwCreateWindow(1, 1, "Simulation", NULL, window);
+        if (simWindow) {
+            createPresentSlots();
+            glFinish();  // Everything made so far must be complete before the other context uses it
+            simThreadRunning = 1;
+            if (!startSimThread()) {
+                simThreadRunning = 0;
+                destroyPresentSlots();
+            }
+        }
+        printf("Simulation thread: %s\n", simThreadRunning ? "on" : "unavailable, stepping on the window thread");
+    }
+
     double lastTime = glfwGetTime();
     double fpsTime = lastTime;
     int frameCount = 0;
@@ -1294,93 +4434,57 @@ int main(void) {
             fpsTime = currentTime;
         }
 
-        // Clamp dt to avoid instability
-        if (dt > 0.1f) dt = 0.1f;
-
-        simulate(dt);
-        render();
-
-        // Render stats overlay
-        char buf[64];
-        snprintf(buf, sizeof(buf), "FPS: %.1f", fps);
-        renderText(buf, 10, 10, 2.0f, 1.0f, 1.0f, 1.0f);
-
-        snprintf(buf, sizeof(buf), "Iterations: %d", pressureIterations);
-        renderText(buf, 10, 30, 2.0f, 1.0f, 1.0f, 1.0f);
-
-        snprintf(buf, sizeof(buf), "Omega: %.3f", pressureOmega);
-        renderText(buf, 10, 50, 2.0f, 1.0f, 1.0f, 1.0f);
-
-        snprintf(buf, sizeof(buf), "Grid: %dx%d", SIM_WIDTH, SIM_HEIGHT);
-        renderText(buf, 10, 70, 2.0f, 1.0f, 1.0f, 1.0f);
-
-        const char* modeNames[] = {"DENSITY", "VELOCITY", "PRE-DIVERGENCE", "POST-DIVERGENCE", "PRESSURE"};
-        snprintf(buf, sizeof(buf), "View: %s", modeNames[displayMode]);
-        renderText(buf, 10, 90, 2.0f, 1.0f, 1.0f, 0.0f);
-
-        if (debugTestMode) {
-            renderText("DEBUG TEST MODE (T to toggle)", 10, 110, 2.0f, 1.0f, 0.3f, 0.3f);
+        // Threaded, the newest published frame; otherwise step here and draw the live state
+        PresentSlot live;
+        const PresentSlot* frame = &live;
+        if (simThreadRunning) {
+            frame = acquirePresentFrame();
+        } else {
+            advanceSimulation(dt);
+            captureLiveFrame(&live);
         }
+        render(frame);
 
-        if (showConvergence) {
-            int preBins[3], preCounts[3], postBins[3], postCounts[3];
-            getTopBins(preBins, preCounts, postBins, postCounts);
-
-            renderText("Pre-projection (worst bins):", 10, 110, 2.0f, 1.0f, 0.8f, 0.5f);
-            for (int i = 0; i < 3 && preBins[i] != -1; i++) {
-                snprintf(buf, sizeof(buf), "  bin %d: %d cells", preBins[i], preCounts[i]);
-                renderText(buf, 10, 130 + i * 20, 2.0f, 1.0f, 0.8f, 0.5f);
-            }
+        // Overlays: queued here, drawn by hudFlush() in one call
+        renderHud(frame, fps);
+        if (simThreadRunning) releasePresentFrame();
 
-            renderText("Post-projection (worst bins):", 10, 210, 2.0f, 0.5f, 1.0f, 0.5f);
-            for (int i = 0; i < 3 && postBins[i] != -1; i++) {
-                snprintf(buf, sizeof(buf), "  bin %d: %d cells", postBins[i], postCounts[i]);
-                renderText(buf, 10, 230 + i * 20, 2.0f, 0.5f, 1.0f, 0.5f);
-            }
-        }
+        hudFlush();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
     // Cleanup
-    glDeleteProgram(advectUProgram);
-    glDeleteProgram(advectVProgram);
-    glDeleteProgram(advectDensityProgram);
-    glDeleteProgram(divergenceProgram);
-    glDeleteProgram(pressureProgram);
-    glDeleteProgram(gradientSubtractUProgram);
-    glDeleteProgram(gradientSubtractVProgram);
-    glDeleteProgram(addForceUProgram);
-    glDeleteProgram(addForceVProgram);
-    glDeleteProgram(addForceDensityProgram);
-    glDeleteProgram(divergenceStatsProgram);
+    if (simThreadRunning) {
+        stopSimThread();
+        destroyPresentSlots();
+        glfwDestroyWindow(simWindow);
+    }
+    destroyPipelines();
     glDeleteProgram(renderProgram);
+    glDeleteProgram(statsOverlayProgram);
+    glDeleteProgram(statsHistoryProgram);
     glDeleteProgram(textProgram);
 
     glDeleteTextures(1, &fontTexture);
-    glDeleteVertexArrays(1, &textVAO);
-    glDeleteBuffers(1, &textVBO);
+    destroyTextBuffers();
 
-    glDeleteBuffers(1, &statsBuffer);
+    releaseDiagnosticsResources();
+    glDeleteBuffers(1, &statsHistoryBuffer);
 
     glDeleteTextures(2, uVelocityTex);
     glDeleteTextures(2, vVelocityTex);
-    glDeleteTextures(2, pressureTex);
-    glDeleteTextures(1, &divergenceTex);
-    glDeleteTextures(1, &postDivergenceTex);
+    destroyTransients();
     glDeleteTextures(2, densityTex);
+    destroyTileBuffers();
+    destroyFlowMetricsBuffers();
 
     glDeleteVertexArrays(1, &quadVAO);
     glDeleteBuffers(1, &quadVBO);
 
-    free(clearDataR);
-    free(clearDataRG);
-    free(clearDataRGBA);
-    free(clearDataU);
-    free(clearDataV);
-
     glfwDestroyWindow(window);
     glfwTerminate();
     return 0;
 }
+#endif // FLUID_NO_MAIN
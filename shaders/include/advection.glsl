@@ -0,0 +1,50 @@
+// Stages of the higher-order advection schemes (advectionScheme in main.c).
+// Each advect_*.comp is built once per stage; with none defined it is the
+// plain semi-Lagrangian step. "src" is the field at the start of the step,
+// x the texel's position and v the velocity there:
+//   ADVECT_PREDICT      hat = src(x - v dt), without dissipation
+//   ADVECT_MACCORMACK   out = hat(x) + (src(x) - hat(x + v dt)) / 2, limited
+//   ADVECT_BFECC_ERROR  tilde = src(x) + (src(x) - hat(x + v dt)) / 2
+//   ADVECT_BFECC_FINAL  out = tilde(x - v dt), limited
+// MacCormack is PREDICT then MACCORMACK; BFECC is PREDICT, BFECC_ERROR and
+// BFECC_FINAL. The intermediate (hat or tilde) is bound as advectedSampler.
+// The limiter clamps to the four src texels the plain step would have blended,
+// so the result never leaves their range: no new extrema, no negative dye.
+#if defined(ADVECT_MACCORMACK) || defined(ADVECT_BFECC_ERROR) || defined(ADVECT_BFECC_FINAL)
+#define ADVECT_READS_INTERMEDIATE
+#endif
+
+// Velocity at a world position; each kernel defines it from its own bindings
+vec2 sampleVelocity(vec2 worldPos);
+
+// Mean velocity along the path that ends at worldPos after time h, so the path
+// started at worldPos - traceVelocity(...) * h (h < 0 traces forward). vel is
+// the velocity at worldPos. Order 1 is the Euler step, 2 the midpoint rule and
+// 3 Ralston's third-order method; the last two sample the velocity on the way,
+// so a long step follows a curved streamline instead of its tangent.
+vec2 traceVelocity(vec2 worldPos, vec2 vel, float h, int order) {
+    if (order <= 1) return vel;
+    vec2 k2 = sampleVelocity(worldPos - 0.5 * h * vel);
+    if (order == 2) return k2;
+    vec2 k3 = sampleVelocity(worldPos - 0.75 * h * k2);
+    return (2.0 * vel + 3.0 * k2 + 4.0 * k3) / 9.0;
+}
+
+float minOf(vec4 t) { return min(min(t.x, t.y), min(t.z, t.w)); }
+float maxOf(vec4 t) { return max(max(t.x, t.y), max(t.z, t.w)); }
+
+// Clamp value to the texels a bilinear sample of field at uv blends (first channel)
+float limitToFootprint(float value, sampler2D field, vec2 uv) {
+    vec4 t = textureGather(field, uv);
+    return clamp(value, minOf(t), maxOf(t));
+}
+
+// Same for all four channels
+vec4 limitToFootprint(vec4 value, sampler2D field, vec2 uv) {
+    vec4 r = textureGather(field, uv, 0);
+    vec4 g = textureGather(field, uv, 1);
+    vec4 b = textureGather(field, uv, 2);
+    vec4 a = textureGather(field, uv, 3);
+    return clamp(value, vec4(minOf(r), minOf(g), minOf(b), minOf(a)),
+                 vec4(maxOf(r), maxOf(g), maxOf(b), maxOf(a)));
+}
@@ -0,0 +1,18 @@
+// Helpers for the general (boundary) build of the split stencil kernels; the
+// INTERIOR build never includes them.
+uniform bool ringDispatch;     // One work group per tile of the outer tile ring
+
+// i-th tile of the outer ring of a tiles.x x tiles.y tile grid: the bottom row,
+// the top row, then the left and right columns in between
+ivec2 ringTile(int i, ivec2 tiles) {
+    if (i < tiles.x) return ivec2(i, 0);
+    i -= tiles.x;
+    if (i < tiles.x) return ivec2(i, tiles.y - 1);
+    i -= tiles.x;
+    return ivec2((i & 1) != 0 ? tiles.x - 1 : 0, 1 + i / 2);
+}
+
+// Pressure outside the grid: Dirichlet p = 0 (open/outflow boundary)
+float boundaryPressure(ivec2 p) {
+    return 0.0;
+}
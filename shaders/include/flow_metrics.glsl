@@ -0,0 +1,45 @@
+// Scalar flow metrics, reduced on the GPU every frame (flow_metrics.comp, then
+// flow_metrics_reduce.comp). Values are in grid units: velocity in cells/s,
+// one cell = 1. The first FLOW_SUMS values add up over the grid, the rest are
+// maxima. Must match FlowMetrics in main.c.
+#define FLOW_KINETIC_ENERGY   0   // 0.5 * sum |u|^2 at cell centres
+#define FLOW_ENSTROPHY        1   // 0.5 * sum w^2 at interior cell corners
+#define FLOW_PRE_DIV_L2       2   // Partials: sum of div^2 before projection; reduced: RMS
+#define FLOW_POST_DIV_L2      3   // ... and after
+#define FLOW_DYE_MASS         4   // sum of r + g + b
+#define FLOW_SUMS             5
+#define FLOW_MAX_U            5   // Largest |u| on any vertical face
+#define FLOW_MAX_V            6   // Largest |v| on any horizontal face
+#define FLOW_MAX_SPEED        7   // Largest |u| at a cell centre
+#define FLOW_PRE_DIV_MAX      8
+#define FLOW_POST_DIV_MAX     9
+#define FLOW_VALUES           10
+
+// Worst-divergence locator: each partial also names the cell holding its
+// tile's largest |divergence| (before and after projection), and the reduce
+// keeps the HOT_SPOTS tiles with the largest of those. One cell per tile, so
+// a single blob cannot take every slot. Cells are packed as x | y << 16.
+#define HOT_SPOTS             4
+#define FLOW_PRE_DIV_CELL     10  // Partials only, as uintBitsToFloat
+#define FLOW_POST_DIV_CELL    11
+#define FLOW_PARTIAL_STRIDE   12
+#define NO_HOT_SPOT           0xFFFFFFFFu
+
+// One partial per 16x16 cell tile, [tile * FLOW_PARTIAL_STRIDE + value]
+layout(std430, binding = 9) buffer FlowPartials {
+    float partials[];
+};
+
+layout(std430, binding = 8) buffer FlowMetrics {
+    float metrics[FLOW_VALUES];
+    uint hotSpotCells[2 * HOT_SPOTS];    // Pre first, then post; largest first
+    float hotSpotValues[2 * HOT_SPOTS];  // |divergence|, 0 where NO_HOT_SPOT
+};
+
+uint packCell(ivec2 cell) {
+    return uint(cell.x) | (uint(cell.y) << 16);
+}
+
+float combineFlowValue(int value, float a, float b) {
+    return value < FLOW_SUMS ? a + b : max(a, b);
+}
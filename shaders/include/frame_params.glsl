@@ -0,0 +1,18 @@
+#include "grid.glsl"
+
+// Per-frame constants, updated once per frame (see FrameParams in main.c)
+layout(std140, binding = 0) uniform FrameParams {
+    float dt;
+    float velocityDissipation;
+    float densityDissipation;
+    int splatCount;     // Splats queued this frame (SplatQueue buffer)
+    float splatRadius;  // Radius of influence (in UV space)
+    float splatCutoff;  // Splats are truncated beyond this distance (UV space)
+    float tileVelocityEpsilon;  // Active-tile thresholds (see tile_mask.comp)
+    float tileDensityEpsilon;
+    int tileMargin;     // Dilation of the active-tile mask, in tiles
+    float solveTolerance;  // Residual below which a pressure tile is skipped
+    int velocityBacktraceOrder;  // 1 Euler, 2 midpoint, 3 RK3 (see traceVelocity)
+    int densityBacktraceOrder;
+    int advectHalo;     // Cells advect_velocity.comp stages around its tile
+};
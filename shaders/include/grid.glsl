@@ -0,0 +1,11 @@
+// Grid sizes. GRID_WIDTH, GRID_HEIGHT and TILE_SIZE are injected by main.c
+// (shaderConfigDefines), so these are constants and the index math folds away.
+const ivec2 cellSize = ivec2(GRID_WIDTH, GRID_HEIGHT);  // 512x512
+const ivec2 uSize = cellSize + ivec2(1, 0);             // 513x512
+const ivec2 vSize = cellSize + ivec2(0, 1);             // 512x513
+const vec2 texelSize = 1.0 / vec2(cellSize);            // 1/512 for cell grid
+
+// Tiles covering the staggered grid (active tiles, 33x33) and the cell grid
+// (pressure tiles, 32x32)
+const ivec2 tileGrid = (max(uSize, vSize) + TILE_SIZE - 1) / TILE_SIZE;
+const ivec2 cellTileGrid = (cellSize + TILE_SIZE - 1) / TILE_SIZE;
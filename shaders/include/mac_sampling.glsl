@@ -0,0 +1,42 @@
+// Bilinear samples of the staggered velocity components at a world position
+// (grid units, cell (i, j) spans [i, i+1] x [j, j+1])
+layout(binding = 0) uniform sampler2D uVelocitySampler;  // 513x512
+layout(binding = 1) uniform sampler2D vVelocitySampler;  // 512x513
+
+// Texture coordinate of world position (wx, wy) in a u-layout texture
+// u[i,j] is stored at texel [i,j] and represents velocity at world pos (i, j+0.5)
+vec2 uTexCoord(vec2 worldPos) {
+    // To sample at world pos (wx, wy):
+    // texel [i,j] has center at UV = ((i+0.5)/width, (j+0.5)/height)
+    // worldPos (wx, wy) corresponds to texel (wx, wy-0.5)
+    // UV = ((wx + 0.5)/width, ((wy-0.5) + 0.5)/height) = ((wx+0.5)/width, wy/height)
+    return vec2((worldPos.x + 0.5) / float(uSize.x), worldPos.y / float(uSize.y));
+}
+
+// Texture coordinate of world position (wx, wy) in a v-layout texture
+// v[i,j] is stored at texel [i,j] and represents velocity at world pos (i+0.5, j)
+vec2 vTexCoord(vec2 worldPos) {
+    // To sample at world pos (wx, wy):
+    // texel [i,j] has center at UV = ((i+0.5)/width, (j+0.5)/height)
+    // worldPos (wx, wy) corresponds to texel (wx-0.5, wy)
+    // UV = ((wx-0.5+0.5)/width, (wy+0.5)/height) = (wx/width, (wy+0.5)/height)
+    return vec2(worldPos.x / float(vSize.x), (worldPos.y + 0.5) / float(vSize.y));
+}
+
+// advect_velocity.comp defines VELOCITY_TILE and samples from shared memory instead
+#ifndef VELOCITY_TILE
+// Sample u-velocity at world position (wx, wy)
+float sampleU(vec2 worldPos) {
+    return texture(uVelocitySampler, uTexCoord(worldPos)).r;
+}
+
+// Sample v-velocity at world position (wx, wy)
+float sampleV(vec2 worldPos) {
+    return texture(vVelocitySampler, vTexCoord(worldPos)).r;
+}
+
+// Both components at world position (wx, wy), for the backtrace
+vec2 sampleVelocity(vec2 worldPos) {
+    return vec2(sampleU(worldPos), sampleV(worldPos));
+}
+#endif
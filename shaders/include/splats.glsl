@@ -0,0 +1,18 @@
+// Mouse stroke segments queued since the last frame (see Splat in main.c)
+struct Splat {
+    vec2 start;         // Segment start (0-1 in cell-center space)
+    vec2 end;           // Segment end
+    vec2 force;         // Force (grid cells/sec)
+    vec4 color;         // Dye color (rgb)
+};
+
+layout(std430, binding = 1) readonly buffer SplatQueue {
+    Splat splats[];
+};
+
+// Distance from p to the segment a-b, so each splat is a capsule along the stroke
+float segmentDistance(vec2 p, vec2 a, vec2 b) {
+    vec2 ab = b - a;
+    float t = clamp(dot(p - a, ab) / max(dot(ab, ab), 1e-12), 0.0, 1.0);
+    return length(p - (a + t * ab));
+}
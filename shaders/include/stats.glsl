@@ -0,0 +1,38 @@
+// Divergence statistics: a 2D histogram of log2|divergence| before (36 bins)
+// and after (32 bins) projection, filled by divergence_stats.comp, and its
+// summary for the HUD from stats_summary.comp. Bin b holds |div| in
+// [2^(b-24), 2^(b-23)); the first and last bins also take everything beyond.
+#define PRE_BINS 36
+#define POST_BINS 32
+#define BIN_EXPONENT_OFFSET 24
+#define STATS_TOP_BINS 3
+#define HISTORY_FRAMES 4096
+
+layout(std430, binding = 0) buffer StatsBuffer {
+    uint histogram[PRE_BINS * POST_BINS];  // [postBin * PRE_BINS + preBin]
+};
+
+// Must match StatsSummary in main.c
+layout(std430, binding = 6) buffer StatsSummary {
+    uint preSums[PRE_BINS];                // Marginals
+    uint postSums[POST_BINS];
+    int topPreBins[STATS_TOP_BINS];        // Highest non-empty bins first, -1 if fewer
+    uint topPreCounts[STATS_TOP_BINS];
+    int topPostBins[STATS_TOP_BINS];
+    uint topPostCounts[STATS_TOP_BINS];
+    uint maxCount;                         // Largest histogram cell (heatmap scale)
+};
+
+// Marginals of the last HISTORY_FRAMES summaries, appended by stats_summary.comp.
+// Entry k (0 = first ever) is in slot k % HISTORY_FRAMES. Must match
+// STATS_HISTORY_BYTES in main.c.
+layout(std430, binding = 7) buffer StatsHistory {
+    uint historyWritten;                           // Entries appended so far
+    uint historyPre[HISTORY_FRAMES * PRE_BINS];    // [slot * PRE_BINS + bin]
+    uint historyPost[HISTORY_FRAMES * POST_BINS];
+};
+
+// Heatmap colour for t in [0, 1] (log-scaled counts), shared by the overlays
+vec3 heatmapRamp(float t) {
+    return mix(vec3(0.306, 0.475, 0.655), vec3(0.929, 0.788, 0.282), t);
+}
@@ -0,0 +1,17 @@
+// Active-tile list (see tile_compact.comp). With tileDispatch set, the kernel is
+// dispatched indirectly with one work group per listed tile; otherwise it runs
+// over the grid, or over a region from dispatchOrigin (see fgAddRegionPass).
+layout(std430, binding = 2) readonly buffer TileList {
+    uint activeCommand[3];
+    uint retireCommand[3];
+    uint tiles[];
+};
+
+uniform bool tileDispatch;
+uniform ivec2 dispatchOrigin;
+
+ivec2 invocationPosition() {
+    if (!tileDispatch) return dispatchOrigin + ivec2(gl_GlobalInvocationID.xy);
+    uint tile = tiles[gl_WorkGroupID.x];
+    return ivec2(int(tile) % tileGrid.x, int(tile) / tileGrid.x) * TILE_SIZE + ivec2(gl_LocalInvocationID.xy);
+}
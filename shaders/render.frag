@@ -3,11 +3,13 @@
 in vec2 TexCoord;
 out vec4 FragColor;
 
-uniform sampler2D densityTex;
-uniform sampler2D divergenceTex;
-uniform sampler2D uVelocityTex;  // 513x512
-uniform sampler2D vVelocityTex;  // 512x513
+layout(binding = 0) uniform sampler2D densityTex;
+layout(binding = 1) uniform sampler2D divergenceTex;
+layout(binding = 2) uniform sampler2D uVelocityTex;  // 513x512
+layout(binding = 3) uniform sampler2D vVelocityTex;  // 512x513
+layout(binding = 4) uniform sampler2D previousDensityTex;  // Dye one step back
 uniform int displayMode;  // 0=density, 1=velocity, 2=divergence, 3=pressure
+uniform float densityBlend;  // Fixed timestep: weight of densityTex over the step before
 
 // Map divergence magnitude to color using log10 scale
 // New Tableau 10 palette: gray (small) -> blue (large), white for [100, 1000)
@@ -97,6 +99,9 @@ void main() {
         FragColor = vec4(color, 1.0);
     } else {
         vec3 density = texture(densityTex, TexCoord).rgb;
+        if (densityBlend < 1.0) {
+            density = mix(texture(previousDensityTex, TexCoord).rgb, density, densityBlend);
+        }
 
         // Apply some tone mapping for nicer visuals
         density = density / (1.0 + density);
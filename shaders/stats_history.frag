@@ -0,0 +1,45 @@
+#version 430 core
+
+// Convergence timeline drawn straight from the StatsHistory ring: the pre and
+// post marginals over the last HISTORY_FRAMES summaries, oldest on the left.
+// Rows are bins (largest divergence on top); each column takes the largest
+// count of its entries, so a one-frame spike stays visible. The headers are
+// HUD text; the layout below must match renderStatsHistory().
+in vec2 panelPos;
+out vec4 FragColor;
+
+#include "include/stats.glsl"
+
+uniform uint cellCount;            // Cells per histogram (colour scale)
+
+const int COLUMNS = 1024;          // Panel width in pixels
+const int ENTRIES_PER_COLUMN = HISTORY_FRAMES / COLUMNS;
+const int ROW_HEIGHT = 3;
+const int POST_Y = 130;            // Pre rows start at 0
+
+void main() {
+    ivec2 p = ivec2(floor(panelPos));
+    bool post = p.y >= POST_Y;
+    int bins = post ? POST_BINS : PRE_BINS;
+    int row = (post ? p.y - POST_Y : p.y) / ROW_HEIGHT;
+    if (row >= bins || p.x >= COLUMNS) discard;
+    int bin = bins - 1 - row;
+
+    // Age 0 is the newest entry, in the rightmost column
+    uint written = historyWritten;
+    uint count = 0u;
+    bool any = false;
+    for (int e = 0; e < ENTRIES_PER_COLUMN; e++) {
+        uint age = uint((COLUMNS - 1 - p.x) * ENTRIES_PER_COLUMN + e);
+        if (age >= written) break;
+        uint slot = (written - 1u - age) % uint(HISTORY_FRAMES);
+        count = max(count, post ? historyPost[slot * uint(POST_BINS) + uint(bin)]
+                                : historyPre[slot * uint(PRE_BINS) + uint(bin)]);
+        any = true;
+    }
+
+    vec3 color = vec3(0.05);                 // Not written yet
+    if (any) color = vec3(0.12);             // Empty bin
+    if (count > 0u) color = heatmapRamp(log2(float(count)) / log2(float(cellCount)));
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,83 @@
+#version 430 core
+
+// Convergence panel drawn straight from the stats SSBOs: the worst-bin lines
+// ("  bin %d: %d cells", formatted here) and the transition heatmap. The
+// headers are HUD text; the layout below must match renderStatsOverlay().
+in vec2 panelPos;
+out vec4 FragColor;
+
+layout(binding = 0) uniform sampler2D fontTex;
+
+#include "include/stats.glsl"
+
+const int GLYPH = 16;          // 8x8 font at scale 2
+const int LINE_PITCH = 20;
+const int POST_LINES_Y = 100;  // Pre lines start at 0
+const int HEATMAP_Y = 190;
+const int HEATMAP_CELL = 8;
+
+int decimalLength(int n) {
+    int length = n < 0 ? 2 : 1;
+    for (int m = abs(n); m >= 10; m /= 10) length++;
+    return length;
+}
+
+// Character k of n in decimal
+int decimalChar(int n, int length, int k) {
+    if (n < 0 && k == 0) return 45;  // '-'
+    int m = abs(n);
+    for (int d = length - 1 - k; d > 0; d--) m /= 10;
+    return 48 + m % 10;
+}
+
+// Character at column col of "  bin <exponent>: <count> cells"
+int lineChar(int exponent, int count, int col) {
+    const int prefix[6] = int[](32, 32, 98, 105, 110, 32);   // "  bin "
+    const int suffix[6] = int[](32, 99, 101, 108, 108, 115); // " cells"
+    if (col < 6) return prefix[col];
+    col -= 6;
+    int length = decimalLength(exponent);
+    if (col < length) return decimalChar(exponent, length, col);
+    col -= length;
+    if (col == 0) return 58;  // ':'
+    if (col == 1) return 32;
+    col -= 2;
+    length = decimalLength(count);
+    if (col < length) return decimalChar(count, length, col);
+    col -= length;
+    return col < 6 ? suffix[col] : 32;
+}
+
+vec3 heatmapColor(uint count) {
+    if (count == 0u) return vec3(0.12);
+    float t = maxCount > 1u ? log2(float(count)) / log2(float(maxCount)) : 1.0;
+    return heatmapRamp(t);
+}
+
+void main() {
+    ivec2 p = ivec2(floor(panelPos));
+
+    // Rows = post bins (top = smallest), columns = pre bins, as printStats2DTable()
+    if (p.y >= HEATMAP_Y) {
+        ivec2 cell = (p - ivec2(0, HEATMAP_Y)) / HEATMAP_CELL;
+        if (cell.x >= PRE_BINS || cell.y >= POST_BINS) discard;
+        FragColor = vec4(heatmapColor(histogram[cell.y * PRE_BINS + cell.x]), 1.0);
+        return;
+    }
+
+    bool post = p.y >= POST_LINES_Y;
+    int y = post ? p.y - POST_LINES_Y : p.y;
+    int line = y / LINE_PITCH;
+    y -= line * LINE_PITCH;
+    if (line >= STATS_TOP_BINS || y >= GLYPH) discard;
+
+    int bin = post ? topPostBins[line] : topPreBins[line];
+    if (bin < 0) discard;
+    int count = int(post ? topPostCounts[line] : topPreCounts[line]);
+    int c = lineChar(bin - BIN_EXPONENT_OFFSET, count, p.x / GLYPH) - 32;
+    if (c <= 0) discard;
+
+    ivec2 texel = ivec2((c % 16) * 8 + (p.x % GLYPH) / 2, (c / 16) * 8 + y / 2);
+    if (texelFetch(fontTex, texel, 0).r < 0.5) discard;
+    FragColor = vec4(post ? vec3(0.5, 1.0, 0.5) : vec3(1.0, 0.8, 0.5), 1.0);
+}
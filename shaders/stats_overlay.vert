@@ -0,0 +1,18 @@
+#version 430 core
+
+// One quad over the convergence panel; stats_overlay.frag draws its contents
+uniform vec2 screenSize;
+uniform vec4 panelRect;  // x, y, width, height in window pixels, top-left origin
+
+out vec2 panelPos;       // Pixels from the panel's top-left corner
+
+const vec2 corners[6] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+                               vec2(0.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+
+void main() {
+    vec2 corner = corners[gl_VertexID];
+    panelPos = corner * panelRect.zw;
+    vec2 ndc = ((panelRect.xy + panelPos) / screenSize) * 2.0 - 1.0;
+    ndc.y = -ndc.y;  // Flip Y so origin is top-left
+    gl_Position = vec4(ndc, 0.0, 1.0);
+}
@@ -1,13 +1,13 @@
 #version 430 core
 
 in vec2 TexCoord;
+flat in vec3 TextColor;
 out vec4 FragColor;
 
-uniform sampler2D fontTex;
-uniform vec3 textColor;
+layout(binding = 0) uniform sampler2D fontTex;
 
 void main() {
     float alpha = texture(fontTex, TexCoord).r;
     if (alpha < 0.5) discard;
-    FragColor = vec4(textColor, alpha);
+    FragColor = vec4(TextColor, alpha);
 }
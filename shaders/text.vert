@@ -1,16 +1,29 @@
 #version 430 core
 
-layout(location = 0) in vec2 aPos;
-layout(location = 1) in vec2 aTexCoord;
+// One instance per glyph (HudGlyph in main.c); six vertices make its quad
+layout(location = 0) in vec3 aGlyph;        // Top-left corner in pixels, scale
+layout(location = 1) in uint aGlyphIndex;   // Font cell (character - 32)
+layout(location = 2) in vec4 aColor;
 
 out vec2 TexCoord;
+flat out vec3 TextColor;
 
 uniform vec2 screenSize;
 
+const vec2 corners[6] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+                               vec2(0.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+
 void main() {
+    vec2 corner = corners[gl_VertexID];
+    vec2 pos = aGlyph.xy + corner * 8.0 * aGlyph.z;
+
     // Convert pixel coordinates to NDC (-1 to 1)
-    vec2 ndc = (aPos / screenSize) * 2.0 - 1.0;
+    vec2 ndc = (pos / screenSize) * 2.0 - 1.0;
     ndc.y = -ndc.y;  // Flip Y so origin is top-left
     gl_Position = vec4(ndc, 0.0, 1.0);
-    TexCoord = aTexCoord;
+
+    // Font texture: 16 cells per row, 8x8 pixels each, 128x64
+    vec2 cell = vec2(float(aGlyphIndex % 16u), float(aGlyphIndex / 16u));
+    TexCoord = (cell + corner) * vec2(8.0 / 128.0, 8.0 / 64.0);
+    TextColor = aColor.rgb;
 }